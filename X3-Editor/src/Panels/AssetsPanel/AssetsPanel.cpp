@@ -3,6 +3,7 @@
 #include "Project/Scene/SceneManager.h"
 #include "Project/Assets/AssetManager.h"
 #include "Dialogs/FilePickerDialog.h"
+#include "Dialogs/FolderPickerDialog.h"
 #include "Panels/DNDPayloads.h"
 #include "ImGuiContextFontRegistry.h"
 #include <format>
@@ -96,6 +97,9 @@ namespace X3
                 // draw asset tiles
                 for (const auto& [guid, metadataPair] : assetPool->Metadata) {
                     const auto& [metadata, metadataExtension] = metadataPair;
+                    if (auto meshMetadata = std::dynamic_pointer_cast<MeshMetadata>(metadata); meshMetadata && meshMetadata->staticBatch) {
+                        continue; // built by the renderer, not a project asset
+                    }
                     std::string filename = metadataExtension->sourcePath.filename().string();
                     DrawAssetTile(guid, filename.c_str());
                     float last_assetTile_x2 = ImGui::GetItemRectMax().x;
@@ -396,12 +400,12 @@ namespace X3
             if (ImGui::Button(deleteLabel)) {
                 shouldDeleteAsset = true;
             }
+            // copied, 'it' is gone once the asset is removed
+            const auto [metadata, metadataExtension] = it->second;
             ConfirmAndExecute(shouldDeleteAsset, ICON_FA_TRASH " Delete Asset", "Are you sure you want to delete this asset?", [&]() {
-                // TODO delete asset  assetManager->DeleteAsset(guid);
+                m_ProjectManager->GetAssetManager()->RemoveAsset(m_SelectedTileGuid);
                 m_SelectedTileGuid = LR_GUID::INVALID;
 			}, m_EditorState);
-
-            const auto& [metadata, metadataExtension] = it->second;
             DrawLabelValue("Source Path:", metadataExtension->sourcePath.string());
 
             // File size formatter (GB > MB > KB > B)
@@ -441,6 +445,83 @@ namespace X3
                 ImGui::Dummy({ 0, 3.0f });
                 DrawLabelValue("BVH Node Count", meshMetadata->nodeCount);
                 DrawLabelValue("BVH FirstNodeIdx:", meshMetadata->firstNodeIdx);
+                DrawLabelValue("BVH Triangle Refs", meshMetadata->indexCount);
+                DrawLabelValue("BVH FirstIndexIdx:", meshMetadata->firstIndexIdx);
+
+                auto meshExtension = std::dynamic_pointer_cast<MeshMetadataExtension>(metadataExtension);
+                if (meshExtension) {
+                    const BVHQualityReport& quality = meshExtension->bvhQuality;
+                    ImGui::Dummy({ 0, 5.0f });
+                    theme.PushColor(ImGuiCol_Text, EditorCol_Accent1);
+                    ImGui::Text("BVH Quality");
+                    theme.PopColor();
+                    DrawLabelValue("Builder:", quality.builder);
+                    DrawLabelValue("SAH Cost:", std::format("{:.2f}", quality.sahCost));
+                    DrawLabelValue("Depth (max / avg leaf):", std::format("{} / {:.1f}", quality.maxDepth, quality.avgLeafDepth));
+                    DrawLabelValue("Leaves:", std::format("{} (avg {:.2f} tris)", quality.leafCount, quality.avgLeafSize));
+                    DrawLabelValue("Sibling Overlap:", std::format("{:.2f} %", quality.siblingOverlapRatio * 100.0f));
+                    if (quality.fromGeometryCache) {
+                        DrawLabelValue("Build Time:", "geometry cache");
+                    } else {
+                        DrawLabelValue("Build Time:", std::format("{:.2f} ms (setup {:.2f}, build {:.2f}, treelets {:.2f}, leaf order {:.2f})",
+                            quality.setupTimeMs + quality.buildTimeMs + quality.optimizeTimeMs + quality.leafOrderTimeMs,
+                            quality.setupTimeMs, quality.buildTimeMs, quality.optimizeTimeMs, quality.leafOrderTimeMs));
+                    }
+
+                    // leaf sizes 1, 2-3, 4-7, ... (BVHQualityReport::LEAF_HISTOGRAM_BUCKETS)
+                    std::array<float, BVHQualityReport::LEAF_HISTOGRAM_BUCKETS> histogram;
+                    std::copy(quality.leafSizeHistogram.begin(), quality.leafSizeHistogram.end(), histogram.begin());
+                    theme.PushColor(ImGuiCol_Text, EditorCol_Text2);
+                    ImGui::Text("Leaf Sizes (1, 2-3, 4-7, ...)");
+                    theme.PopColor();
+                    ImGui::PlotHistogram("##LeafSizes", histogram.data(), static_cast<int>(histogram.size()), 0, nullptr,
+                        0.0f, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 48.0f));
+
+                    if (ImGui::Button(ICON_FA_FILE_EXPORT " Export Reports")) {
+                        if (auto folder = FolderPickerDialog("Select folder"); !folder.empty()) {
+                            m_ProjectManager->GetAssetManager()->ExportBVHQualityReports(folder / "BVHQualityReport.json");
+                        }
+                    }
+                }
+
+                // BVH build options - edited locally until the BVH is rebuilt
+                static LR_GUID editedGuid = LR_GUID::INVALID;
+                static BVHBuildOptions editedOptions;
+                if (meshExtension && editedGuid != m_SelectedTileGuid) {
+                    editedGuid = m_SelectedTileGuid;
+                    editedOptions = meshExtension->bvhOptions;
+                }
+
+                ImGui::Dummy({ 0, 3.0f });
+                theme.PushColor(ImGuiCol_CheckMark, EditorCol_Text1);
+                theme.PushColor(ImGuiCol_Text, EditorCol_Text2);
+                ImGui::Text("Spatial Splits");
+                theme.PopColor();
+                ImGui::SameLine();
+                ImGui::Checkbox("##SpatialSplits", &editedOptions.spatialSplits);
+                theme.PopColor();
+
+                ImGui::BeginDisabled(!editedOptions.spatialSplits);
+                theme.PushColor(ImGuiCol_Text, EditorCol_Text2);
+                ImGui::Text("Duplication Budget");
+                theme.PopColor();
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+                ImGui::SliderFloat("##DuplicationBudget", &editedOptions.duplicationBudget, 0.0f, 1.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+                ImGui::EndDisabled();
+
+                theme.PushColor(ImGuiCol_CheckMark, EditorCol_Text1);
+                theme.PushColor(ImGuiCol_Text, EditorCol_Text2);
+                ImGui::Text("Treelet Optimization");
+                theme.PopColor();
+                ImGui::SameLine();
+                ImGui::Checkbox("##TreeletOptimization", &editedOptions.treeletOptimization);
+                theme.PopColor();
+
+                // replaces the metadata - meshMetadata must not be used after this
+                if (ImGui::Button(ICON_FA_ARROWS_ROTATE " Rebuild BVH")) {
+                    m_ProjectManager->GetAssetManager()->RebuildMeshBVH(m_SelectedTileGuid, editedOptions);
+                }
             }
 
             // Try cast to TextureMetadata
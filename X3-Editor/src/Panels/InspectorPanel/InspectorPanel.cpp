@@ -133,6 +133,21 @@ namespace X3
 					{0, 0},
 					!sourceName.empty()
 				);
+
+				theme.PushColor(ImGuiCol_Text, EditorCol_Text2);
+				ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(4, 1));  // thinner widgets
+				ImGui::AlignTextToFramePadding();
+				ImGui::Text("Static:");
+				theme.PopColor();
+				ImGui::SameLine();
+				theme.PushColor(ImGuiCol_CheckMark, EditorCol_Text1);
+				theme.PushColor(ImGuiCol_FrameBg, EditorCol_Primary1);
+				ImGui::Checkbox("##StaticMeshCheckbox", &entity.GetComponent<MeshComponent>().isStatic);
+				theme.PopColor(2);
+				ImGui::PopStyleVar();
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("Merged with all other static meshes into one world space BVH.\nMoving it rebuilds that BVH.");
+				}
 			}
 		);
 
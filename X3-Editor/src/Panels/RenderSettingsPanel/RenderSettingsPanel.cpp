@@ -156,6 +156,98 @@ namespace X3
 			ImGui::PushItemWidth(-FLT_MIN);
 			ImGui::SliderInt("##RuntimeBounces", &runtimeSettings.bouncesPerRay, 0, 100);
 
+			// BVH Width (binary or collapsed wide BVH traversal)
+			auto BVHWidthCombo = [&](const char* id, RenderSettings& settings) {
+				constexpr int widths[] = { 2, 4, 8 };
+				constexpr const char* labels[] = { "Binary", "4-wide", "8-wide" };
+				int current_idx = 0;
+				for (int i = 0; i < 3; i++) {
+					if (widths[i] == settings.bvhWidth) { current_idx = i; break; }
+				}
+				ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+				if (ImGui::Combo(id, &current_idx, labels, 3)) {
+					settings.bvhWidth = widths[current_idx];
+					return true;
+				}
+				return false;
+			};
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			DrawLabel("BVH Width");
+			ImGui::TableSetColumnIndex(1);
+			if (BVHWidthCombo("##EditorBVHWidth", editorSettings)) {
+				m_EventDispatcher->dispatchEvent(std::make_shared<UpdateRenderSettingsEvent>(editorSettings));
+			}
+			ImGui::TableSetColumnIndex(2);
+			BVHWidthCombo("##RuntimeBVHWidth", runtimeSettings);
+
+			// Quantized BVH (wide BVHs only)
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			DrawLabel("Quantized BVH");
+			ImGui::TableSetColumnIndex(1);
+			ImGui::BeginDisabled(editorSettings.bvhWidth == 2);
+			if (ImGui::Checkbox("##EditorQuantizedBVH", &editorSettings.quantizedBVH)) {
+				m_EventDispatcher->dispatchEvent(std::make_shared<UpdateRenderSettingsEvent>(editorSettings));
+			}
+			ImGui::EndDisabled();
+			ImGui::TableSetColumnIndex(2);
+			ImGui::BeginDisabled(runtimeSettings.bvhWidth == 2);
+			ImGui::Checkbox("##RuntimeQuantizedBVH", &runtimeSettings.quantizedBVH);
+			ImGui::EndDisabled();
+
+			// Wavefront (staged passes over ray queues instead of the megakernel)
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			DrawLabel("Wavefront");
+			ImGui::TableSetColumnIndex(1);
+			if (ImGui::Checkbox("##EditorWavefront", &editorSettings.wavefront)) {
+				m_EventDispatcher->dispatchEvent(std::make_shared<UpdateRenderSettingsEvent>(editorSettings));
+			}
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Checkbox("##RuntimeWavefront", &runtimeSettings.wavefront);
+
+			// Persistent Threads (megakernel only)
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			DrawLabel("Persistent Threads");
+			ImGui::TableSetColumnIndex(1);
+			ImGui::BeginDisabled(editorSettings.wavefront);
+			if (ImGui::Checkbox("##EditorPersistentThreads", &editorSettings.persistentThreads)) {
+				m_EventDispatcher->dispatchEvent(std::make_shared<UpdateRenderSettingsEvent>(editorSettings));
+			}
+			ImGui::EndDisabled();
+			ImGui::TableSetColumnIndex(2);
+			ImGui::BeginDisabled(runtimeSettings.wavefront);
+			ImGui::Checkbox("##RuntimePersistentThreads", &runtimeSettings.persistentThreads);
+			ImGui::EndDisabled();
+
+			// Next Event Estimation (explicit light sampling)
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			DrawLabel("Next Event Estimation");
+			ImGui::TableSetColumnIndex(1);
+			if (ImGui::Checkbox("##EditorNextEventEstimation", &editorSettings.nextEventEstimation)) {
+				m_EventDispatcher->dispatchEvent(std::make_shared<UpdateRenderSettingsEvent>(editorSettings));
+			}
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Checkbox("##RuntimeNextEventEstimation", &runtimeSettings.nextEventEstimation);
+
+			// Any Hit Shadow Rays (next event estimation only)
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			DrawLabel("Any Hit Shadow Rays");
+			ImGui::TableSetColumnIndex(1);
+			ImGui::BeginDisabled(!editorSettings.nextEventEstimation);
+			if (ImGui::Checkbox("##EditorAnyHitShadowRays", &editorSettings.anyHitShadowRays)) {
+				m_EventDispatcher->dispatchEvent(std::make_shared<UpdateRenderSettingsEvent>(editorSettings));
+			}
+			ImGui::EndDisabled();
+			ImGui::TableSetColumnIndex(2);
+			ImGui::BeginDisabled(!runtimeSettings.nextEventEstimation);
+			ImGui::Checkbox("##RuntimeAnyHitShadowRays", &runtimeSettings.anyHitShadowRays);
+			ImGui::EndDisabled();
+
 			// Accumulate
 			ImGui::TableNextRow();
 			ImGui::TableSetColumnIndex(0);
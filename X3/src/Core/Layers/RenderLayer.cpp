@@ -24,7 +24,10 @@ namespace X3
 
 	void RenderLayer::onUpdate() {
 		if (m_ProjectManager->ProjectIsOpen()) { // Get...Manager should not return nullptr
+			m_ProjectManager->GetAssetManager()->ApplyFinishedBVHBuilds();
+			m_ProjectManager->GetAssetManager()->CompactAssetPool();
 			const auto& scene = m_ProjectManager->GetSceneManager()->GetOpenScene();
+			m_Renderer.UpdateStaticBatch(scene.get(), *m_ProjectManager->GetAssetManager());
 			const auto& assetPool = m_ProjectManager->GetAssetManager()->GetAssetPool();
 			std::shared_ptr<IImage2D> RenderedFrame = m_Renderer.Render(scene.get(), assetPool.get());
 			m_EventDispatcher->dispatchEvent(std::make_shared<NewFrameRenderedEvent>(RenderedFrame));
@@ -0,0 +1,126 @@
+#include "Core/ThreadPool.h"
+
+namespace X3
+{
+
+	// identifies the worker a thread belongs to (nullptr for threads not owned by a pool)
+	static thread_local const ThreadPool* t_OwningPool = nullptr;
+	static thread_local uint32_t t_WorkerIdx = 0;
+
+	ThreadPool::ThreadPool(uint32_t threadCount) {
+		if (threadCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 1; // the waiting thread helps out
+		}
+
+		m_Queues.reserve(threadCount + 1);
+		for (uint32_t i = 0; i < threadCount + 1; i++) {
+			m_Queues.emplace_back(std::make_unique<WorkQueue>());
+		}
+
+		m_Workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_SleepMutex);
+			m_Stop = true;
+		}
+		m_WakeCondition.notify_all();
+		for (auto& worker : m_Workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool& ThreadPool::Get() {
+		static ThreadPool s_Pool;
+		return s_Pool;
+	}
+
+	void ThreadPool::Submit(Job job, JobCounter& counter) {
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		WorkQueue& queue = *m_Queues[CurrentQueueIdx()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back({ std::move(job), &counter });
+		}
+		{
+			// taking the lock orders the increment against a worker about to sleep
+			std::lock_guard<std::mutex> lock(m_SleepMutex);
+			m_QueuedTasks.fetch_add(1, std::memory_order_release);
+		}
+		m_WakeCondition.notify_one();
+	}
+
+	void ThreadPool::Wait(JobCounter& counter) {
+		const uint32_t ownQueue = CurrentQueueIdx();
+		while (counter.pending.load(std::memory_order_acquire) != 0) {
+			Task task;
+			if (TryPop(ownQueue, task)) {
+				Execute(task);
+			} else {
+				std::this_thread::yield(); // remaining jobs are running on other threads
+			}
+		}
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t workerIdx) {
+		t_OwningPool = this;
+		t_WorkerIdx = workerIdx;
+
+		while (true) {
+			Task task;
+			if (TryPop(workerIdx, task)) {
+				Execute(task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_WakeCondition.wait(lock, [this]() {
+				return m_Stop || m_QueuedTasks.load(std::memory_order_acquire) != 0;
+			});
+			if (m_Stop) {
+				return;
+			}
+		}
+	}
+
+	bool ThreadPool::TryPop(uint32_t ownQueue, Task& outTask) {
+		{
+			WorkQueue& queue = *m_Queues[ownQueue];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				outTask = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				m_QueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		// steal the oldest (usually largest) job of another queue
+		const uint32_t queueCount = static_cast<uint32_t>(m_Queues.size());
+		for (uint32_t i = 1; i < queueCount; i++) {
+			WorkQueue& victim = *m_Queues[(ownQueue + i) % queueCount];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				outTask = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				m_QueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::Execute(Task& task) {
+		task.job();
+		task.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	uint32_t ThreadPool::CurrentQueueIdx() const {
+		return (t_OwningPool == this) ? t_WorkerIdx : static_cast<uint32_t>(m_Queues.size() - 1);
+	}
+}
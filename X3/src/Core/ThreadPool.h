@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lrpch.h"
+#include <deque>
+#include <condition_variable>
+
+namespace X3
+{
+
+	// ============================================================================
+	// THREAD POOL
+	// ----------------------------------------------------------------------------
+	// Work-stealing pool for fork/join style CPU work (e.g. BVH construction).
+	// Every worker owns a deque: it pushes and pops its own jobs at the back (LIFO)
+	// and steals from the front of the other deques (FIFO) once it runs dry.
+	// A thread waiting on a JobCounter keeps executing queued jobs instead of
+	// blocking, so nested fork/join scopes never deadlock the pool.
+	// ============================================================================
+	class ThreadPool {
+	public:
+		using Job = std::function<void()>;
+
+		/// Tracks the outstanding jobs of one fork/join scope.
+		struct JobCounter {
+			std::atomic<uint32_t> pending{ 0 };
+		};
+
+		/// 'threadCount' == 0 picks one worker per hardware thread minus the calling thread.
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		// non movable, non copyable
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/// Engine-wide pool, created on first use.
+		static ThreadPool& Get();
+
+		/// Queues 'job'; 'counter' stays non-zero until the job has finished.
+		void Submit(Job job, JobCounter& counter);
+
+		/// Executes queued jobs on the calling thread until 'counter' reaches zero.
+		void Wait(JobCounter& counter);
+
+		inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	private:
+		struct Task {
+			Job job;
+			JobCounter* counter = nullptr;
+		};
+
+		struct WorkQueue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void WorkerLoop(uint32_t workerIdx);
+
+		/// Pops from the back of 'ownQueue' or steals from the front of any other queue.
+		bool TryPop(uint32_t ownQueue, Task& outTask);
+		void Execute(Task& task);
+
+		/// Index of the calling thread's queue (the shared queue for non-worker threads).
+		uint32_t CurrentQueueIdx() const;
+
+		std::vector<std::thread> m_Workers;
+		std::vector<std::unique_ptr<WorkQueue>> m_Queues; // one per worker + one shared by external threads
+
+		std::mutex m_SleepMutex;
+		std::condition_variable m_WakeCondition;
+		std::atomic<uint32_t> m_QueuedTasks{ 0 };
+		std::atomic<bool> m_Stop{ false };
+	};
+}
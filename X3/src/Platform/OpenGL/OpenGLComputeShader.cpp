@@ -1,12 +1,13 @@
 #include <GL/glew.h>
 #include "Platform/OpenGL/OpenGLComputeShader.h"
 #include "Platform/OpenGL/OpenGLdebugFuncs.h"
+#include "Platform/OpenGL/OpenGLShaderStorageBuffer.h"
 
 namespace X3 
 {
 
-	OpenGLComputeShader::OpenGLComputeShader(const std::string& filepath, const glm::uvec3& workGroupSizes)
-		: m_Filepath(filepath), m_WorkGroupSizes(workGroupSizes), m_ID(0) {
+	OpenGLComputeShader::OpenGLComputeShader(const std::string& filepath, const glm::uvec3& workGroupSizes, const std::vector<std::string>& defines)
+		: m_Filepath(filepath), m_Defines(defines), m_WorkGroupSizes(workGroupSizes), m_ID(0) {
 		CreateShader();
 	}
 
@@ -27,9 +28,11 @@ namespace X3
 	}
 
 	void OpenGLComputeShader::Dispatch() {
+		#ifdef MEASURE_GPU_RENDER_TIME
 		GLuint query;
 		glGenQueries(1, &query);
 		glBeginQuery(GL_TIME_ELAPSED, query);
+		#endif
 		
 		glDispatchCompute(m_WorkGroupSizes.x, m_WorkGroupSizes.y, m_WorkGroupSizes.z);
 		GLCall(glMemoryBarrier(GL_ALL_BARRIER_BITS));
@@ -55,6 +58,13 @@ namespace X3
 		#endif
 	}
 
+	void OpenGLComputeShader::DispatchIndirect(const IShaderStorageBuffer& args, uint64_t offset) {
+		GLCall(glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, static_cast<const OpenGLShaderStorageBuffer&>(args).GetID()));
+		GLCall(glDispatchComputeIndirect(static_cast<GLintptr>(offset)));
+		GLCall(glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0));
+		GLCall(glMemoryBarrier(GL_ALL_BARRIER_BITS)); // the next stage reads what this one wrote, its arguments included
+	}
+
 	std::string OpenGLComputeShader::ParseShaderFile() {
 		std::ifstream stream(m_Filepath);
 		if (!stream.is_open()) {
@@ -65,6 +75,11 @@ namespace X3
 		std::string line;
 		while (getline(stream, line)) {
 			ss << line << '\n';
+			if (line.rfind("#version", 0) == 0) { // nothing but comments may precede it
+				for (const std::string& define : m_Defines) {
+					ss << "#define " << define << '\n';
+				}
+			}
 		}
 		std::string source = ss.str();
 		return source;
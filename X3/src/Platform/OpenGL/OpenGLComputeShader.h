@@ -8,12 +8,13 @@ namespace X3
 
 	class OpenGLComputeShader : public IComputeShader {
 	public:
-		OpenGLComputeShader(const std::string& filepath, const glm::uvec3& workGroupSizes);
+		OpenGLComputeShader(const std::string& filepath, const glm::uvec3& workGroupSizes, const std::vector<std::string>& defines = {});
 		~OpenGLComputeShader();
 
 		virtual void Bind() override;
 		virtual void Unbind() override;
 		virtual void Dispatch() override;
+		virtual void DispatchIndirect(const IShaderStorageBuffer& args, uint64_t offset) override;
 
 		/// SETTERS ///
 		inline virtual void setWorkGroupSizes(const glm::uvec3 workGroupSizes) override { m_WorkGroupSizes = workGroupSizes; };
@@ -27,6 +28,7 @@ namespace X3
 		uint32_t m_ID;
 		glm::uvec3 m_WorkGroupSizes;
 		const std::string m_Filepath;
+		const std::vector<std::string> m_Defines;
 
 	private:
 		void CreateShader();
@@ -5,12 +5,28 @@
 namespace X3
 {
 
-	OpenGLShaderStorageBuffer::OpenGLShaderStorageBuffer(uint32_t size, uint32_t bindingPoint, BufferUsageType type)
-		: m_ID(0), m_Size(size), m_BindingPoint(bindingPoint), m_UsageType(type) {
+	OpenGLShaderStorageBuffer::OpenGLShaderStorageBuffer(uint64_t size, uint32_t bindingPoint, BufferUsageType type, bool atomicCounter)
+		: m_ID(0), m_BindingPoint(bindingPoint), m_BindingTarget(atomicCounter ? GL_ATOMIC_COUNTER_BUFFER : GL_SHADER_STORAGE_BUFFER), m_Size(size), m_UsageType(type) {
 		GLCall(glGenBuffers(1, &m_ID));
 		GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID));
-		GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, m_Size, nullptr, (m_UsageType == BufferUsageType::STATIC_DRAW) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW));
-		GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, m_BindingPoint, m_ID)); // binding the UBO to the binding point
+		GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(m_Size), nullptr, (m_UsageType == BufferUsageType::STATIC_DRAW) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW));
+		GLCall(glBindBufferBase(m_BindingTarget, m_BindingPoint, m_ID)); // binding the UBO to the binding point
+	}
+
+	OpenGLShaderStorageBuffer::~OpenGLShaderStorageBuffer() {
+		if (m_ID != 0) {
+			GLCall(glDeleteBuffers(1, &m_ID));
+			m_ID = 0;
+		}
+	}
+
+	uint64_t OpenGLShaderStorageBuffer::GetMaxBlockSize() {
+		static const uint64_t maxBlockSize = []() {
+			GLint64 size = 0;
+			GLCall(glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &size));
+			return static_cast<uint64_t>(size);
+		}();
+		return maxBlockSize;
 	}
 
 	void OpenGLShaderStorageBuffer::Bind() {
@@ -22,20 +38,29 @@ namespace X3
 		GLCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
 	}
 
-	void OpenGLShaderStorageBuffer::AddData(uint32_t offset, uint32_t dataSize, const void* data) {
-		GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, dataSize, data));
+	void OpenGLShaderStorageBuffer::AddData(uint64_t offset, uint64_t dataSize, const void* data) {
+		GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(dataSize), data));
+	}
+
+	void OpenGLShaderStorageBuffer::CopyData(const IShaderStorageBuffer& source, uint64_t sourceOffset, uint64_t offset, uint64_t dataSize) {
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, static_cast<const OpenGLShaderStorageBuffer&>(source).m_ID));
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, m_ID));
+		GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(sourceOffset),
+								   static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(dataSize)));
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
 	}
 
 	void OpenGLShaderStorageBuffer::SetBindingPoint(uint32_t bindingPoint) {
 		m_BindingPoint = bindingPoint;
-		GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, m_BindingPoint, m_ID));
+		GLCall(glBindBufferBase(m_BindingTarget, m_BindingPoint, m_ID));
 	}
 
-	void* OpenGLShaderStorageBuffer::ReadData(uint32_t offset, uint32_t dataSize) {
+	void* OpenGLShaderStorageBuffer::ReadData(uint64_t offset, uint64_t dataSize) {
 		Bind();
 		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); // make sure all data has been written before proceeding
 
-		void* dataPtr = (void*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, offset, dataSize, GL_MAP_READ_BIT);
+		void* dataPtr = (void*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(dataSize), GL_MAP_READ_BIT);
 
 		if (dataPtr == nullptr) {
 			LOG_ENGINE_CRITICAL("[ERROR] reading SSBO Buffer");
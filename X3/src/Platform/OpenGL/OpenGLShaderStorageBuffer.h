@@ -8,19 +8,29 @@ namespace X3
 
 	class OpenGLShaderStorageBuffer : public IShaderStorageBuffer {
 	public:
-		OpenGLShaderStorageBuffer(uint32_t size, uint32_t bindingPoint, BufferUsageType type);
+		/// 'atomicCounter' binds to GL_ATOMIC_COUNTER_BUFFER binding points instead of GL_SHADER_STORAGE_BUFFER ones
+		OpenGLShaderStorageBuffer(uint64_t size, uint32_t bindingPoint, BufferUsageType type, bool atomicCounter = false);
+		~OpenGLShaderStorageBuffer();
+
+		/// GL_MAX_SHADER_STORAGE_BLOCK_SIZE, queried once
+		static uint64_t GetMaxBlockSize();
 
 		virtual void Bind() override;
 		virtual void Unbind() override;
 
-		virtual void AddData(uint32_t offset, uint32_t dataSize, const void* data) override;
+		virtual void AddData(uint64_t offset, uint64_t dataSize, const void* data) override;
+		virtual void CopyData(const IShaderStorageBuffer& source, uint64_t sourceOffset, uint64_t offset, uint64_t dataSize) override;
 
 		virtual void SetBindingPoint(uint32_t bindingPoint) override;
 
-		virtual void* ReadData(uint32_t offset, uint32_t dataSize) override;
+		virtual void* ReadData(uint64_t offset, uint64_t dataSize) override;
+
+		inline uint32_t GetID() const { return m_ID; }
 
 	private:
-		uint32_t m_ID, m_Size, m_BindingPoint;
+		uint32_t m_ID, m_BindingPoint;
+		uint32_t m_BindingTarget; // GLenum
+		uint64_t m_Size;
 		BufferUsageType m_UsageType;
 	};
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ namespace X3
 	class OpenGLTexture2D : public ITexture2D {
 	public:
 		OpenGLTexture2D(const unsigned char* data, const int width, const int height, int textureUnit);
+		OpenGLTexture2D(const float* data, const int width, const int height, int textureUnit); // GL_R32F
 		virtual ~OpenGLTexture2D() override;
 		virtual void ChangeTextureUnit(int textureUnit) override;
 		inline virtual int GetID() const override { return m_ID; }
@@ -22,10 +22,23 @@ namespace X3
 			return false;
 		}
 
+        const BVHBuildOptions& bvhOptions = assetMetafile.bvhOptions;
+        const MeshImportOptions& meshOptions = assetMetafile.meshOptions;
         YAML::Emitter out;
         out << YAML::BeginMap 
             << YAML::Key << "Guid" << YAML::Value << (uint64_t)assetMetafile.guid 
 			<< YAML::Key << "SourcePath" << YAML::Value << assetMetafile.sourcePath.string()
+			<< YAML::Key << "BVH" << YAML::Value << YAML::BeginMap
+				<< YAML::Key << "BinCount" << YAML::Value << bvhOptions.binCount
+				<< YAML::Key << "SpatialSplits" << YAML::Value << bvhOptions.spatialSplits
+				<< YAML::Key << "DuplicationBudget" << YAML::Value << bvhOptions.duplicationBudget
+				<< YAML::Key << "LeafOrderedTriangles" << YAML::Value << bvhOptions.leafOrderedTriangles
+				<< YAML::Key << "TreeletOptimization" << YAML::Value << bvhOptions.treeletOptimization
+			<< YAML::EndMap
+			<< YAML::Key << "Mesh" << YAML::Value << YAML::BeginMap
+				<< YAML::Key << "IndexedVertices" << YAML::Value << meshOptions.indexedVertices
+				<< YAML::Key << "PrecomputedTriangles" << YAML::Value << meshOptions.precomputedTriangles
+			<< YAML::EndMap
             << YAML::EndMap;
 
 		std::ofstream fout(metafilePath);
@@ -54,6 +67,21 @@ namespace X3
             metafile.guid = (LR_GUID)root["Guid"].as<uint64_t>();
 			metafile.sourcePath = std::filesystem::path{root["SourcePath"].as<std::string>()};
 
+			// optional, older metafiles don't have it
+			if (const YAML::Node bvhNode = root["BVH"]) {
+				BVHBuildOptions& bvhOptions = metafile.bvhOptions;
+				bvhOptions.binCount = bvhNode["BinCount"].as<uint32_t>(bvhOptions.binCount);
+				bvhOptions.spatialSplits = bvhNode["SpatialSplits"].as<bool>(bvhOptions.spatialSplits);
+				bvhOptions.duplicationBudget = bvhNode["DuplicationBudget"].as<float>(bvhOptions.duplicationBudget);
+				bvhOptions.leafOrderedTriangles = bvhNode["LeafOrderedTriangles"].as<bool>(bvhOptions.leafOrderedTriangles);
+				bvhOptions.treeletOptimization = bvhNode["TreeletOptimization"].as<bool>(bvhOptions.treeletOptimization);
+			}
+			if (const YAML::Node meshNode = root["Mesh"]) {
+				MeshImportOptions& meshOptions = metafile.meshOptions;
+				meshOptions.indexedVertices = meshNode["IndexedVertices"].as<bool>(meshOptions.indexedVertices);
+				meshOptions.precomputedTriangles = meshNode["PrecomputedTriangles"].as<bool>(meshOptions.precomputedTriangles);
+			}
+
 			LOG_ENGINE_INFO("LoadMetaFile: loaded metadata for GUID {0}", (uint64_t)metafile.guid);
             return std::make_optional(metafile);
         }
@@ -64,7 +92,212 @@ namespace X3
     }
 
 
-     
+
+	// GEOMETRY CACHE FILE ---------------------------------------------------------------------
+	namespace {
+		constexpr char GEOMETRY_CACHE_MAGIC[4] = { 'L', 'R', 'G', 'C' };
+		constexpr uint32_t GEOMETRY_CACHE_FORMAT_VERSION = 4;
+
+		// GeometryCacheHeader::flags
+		constexpr uint32_t GEOMETRY_CACHE_SPATIAL_SPLITS = 1 << 0;
+		constexpr uint32_t GEOMETRY_CACHE_LEAF_ORDERED = 1 << 1;
+		constexpr uint32_t GEOMETRY_CACHE_INDEXED_VERTICES = 1 << 2;
+		constexpr uint32_t GEOMETRY_CACHE_PRECOMPUTED_TRIANGLES = 1 << 3;
+		constexpr uint32_t GEOMETRY_CACHE_TREELET_OPTIMIZED = 1 << 4;
+
+		// 72 bytes, no padding - followed by the triangles (or vertices & faces), nodes, indices and triangle order
+		struct GeometryCacheHeader {
+			char magic[4];
+			uint32_t formatVersion;
+			uint32_t builderVersion;
+			uint32_t binCount;
+			uint64_t sourceHash;
+			uint64_t sourceSize;
+			uint32_t flags;
+			float duplicationBudget;
+			float spatialSplitAlpha;
+			uint32_t triangleSize;		// catches layout changes of the stored structs (sizeof(Face) for indexed meshes)
+			uint32_t nodeSize;
+			uint32_t triCount;
+			uint32_t nodeCount;
+			uint32_t indexCount;
+			uint32_t vertexCount;		// 0 unless indexed
+			uint32_t triangleOrderCount; // MeshMetadataExtension::triangleOrder, 0 while in source order
+		};
+		static_assert(sizeof(GeometryCacheHeader) == 72);
+
+		GeometryCacheHeader MakeGeometryCacheHeader(const GeometryCacheKey& key) {
+			GeometryCacheHeader header{};
+			std::copy(std::begin(GEOMETRY_CACHE_MAGIC), std::end(GEOMETRY_CACHE_MAGIC), header.magic);
+			header.formatVersion = GEOMETRY_CACHE_FORMAT_VERSION;
+			header.builderVersion = BVHAccel::BUILDER_VERSION;
+			header.binCount = key.bvhOptions.binCount;
+			header.sourceHash = key.sourceHash;
+			header.sourceSize = key.sourceSize;
+			header.flags = (key.bvhOptions.spatialSplits ? GEOMETRY_CACHE_SPATIAL_SPLITS : 0) |
+						   (key.bvhOptions.leafOrderedTriangles ? GEOMETRY_CACHE_LEAF_ORDERED : 0) |
+						   (key.bvhOptions.treeletOptimization ? GEOMETRY_CACHE_TREELET_OPTIMIZED : 0) |
+						   (key.meshOptions.indexedVertices ? GEOMETRY_CACHE_INDEXED_VERTICES : 0) |
+						   (key.meshOptions.precomputedTriangles && !key.meshOptions.indexedVertices ? GEOMETRY_CACHE_PRECOMPUTED_TRIANGLES : 0);
+			// budget & alpha don't shape the tree without spatial splits
+			header.duplicationBudget = key.bvhOptions.spatialSplits ? key.bvhOptions.duplicationBudget : 0.0f;
+			header.spatialSplitAlpha = key.bvhOptions.spatialSplits ? key.bvhOptions.spatialSplitAlpha : 0.0f;
+			header.triangleSize = key.meshOptions.indexedVertices ? sizeof(Face) : sizeof(Triangle);
+			header.nodeSize = sizeof(BVHAccel::Node);
+			return header;
+		}
+
+		// BVHQualityReport::builder of a binned SAH build with these options
+		std::string BVHBuilderName(const BVHBuildOptions& options) {
+			return std::string(options.spatialSplits ? "SBVH" : "SAH") + (options.treeletOptimization ? "+Treelets" : "");
+		}
+
+		// quoted & escaped JSON string literal
+		std::string JsonString(const std::string& str) {
+			std::string out = "\"";
+			for (char c : str) {
+				if (c == '"' || c == '\\') {
+					out += '\\';
+					out += c;
+				} else if (static_cast<unsigned char>(c) < 0x20) {
+					out += fmt::format("\\u{:04x}", static_cast<int>(c));
+				} else {
+					out += c;
+				}
+			}
+			return out + "\"";
+		}
+	}
+
+	std::optional<uint64_t> HashFileContents(const std::filesystem::path& filepath) {
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file.is_open()) {
+			return std::nullopt;
+		}
+
+		// FNV-1a over 8 byte words (zero padded tail) with an extra fold, good enough to detect edits
+		uint64_t hash = 14695981039346656037ull;
+		std::vector<char> chunk(1 << 20);
+		while (file) {
+			file.read(chunk.data(), chunk.size());
+			const size_t readBytes = static_cast<size_t>(file.gcount());
+			std::fill(chunk.begin() + readBytes, chunk.begin() + std::min(chunk.size(), (readBytes + 7) & ~size_t(7)), 0);
+			for (size_t i = 0; i < readBytes; i += 8) {
+				uint64_t word;
+				std::memcpy(&word, chunk.data() + i, sizeof(word));
+				hash = (hash ^ word) * 1099511628211ull;
+				hash ^= hash >> 29;
+			}
+		}
+		return file.eof() ? std::make_optional(hash) : std::nullopt;
+	}
+
+	bool SaveGeometryCache(const std::filesystem::path& cachepath, const GeometryCacheKey& key, const AssetPool& assetPool, const MeshMetadata& metadata,
+						   const std::vector<uint32_t>& triangleOrder) {
+		GeometryCacheHeader header = MakeGeometryCacheHeader(key);
+		header.triCount = metadata.TriCount;
+		header.nodeCount = metadata.nodeCount;
+		header.indexCount = metadata.indexCount;
+		header.vertexCount = metadata.indexedVertices ? metadata.vertexCount : 0;
+		header.triangleOrderCount = static_cast<uint32_t>(triangleOrder.size());
+
+		std::ofstream file(cachepath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			LOG_ENGINE_ERROR("SaveGeometryCache: could not open {0} for writing - permissions or path invalid", cachepath.string());
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (metadata.indexedVertices) {
+			file.write(reinterpret_cast<const char*>(&assetPool.VertexBuffer[metadata.firstVertexIdx]), sizeof(glm::vec3) * metadata.vertexCount);
+			file.write(reinterpret_cast<const char*>(&assetPool.FaceBuffer[metadata.firstTriIdx]), sizeof(Face) * metadata.TriCount);
+		} else {
+			file.write(reinterpret_cast<const char*>(&assetPool.MeshBuffer[metadata.firstTriIdx]), sizeof(Triangle) * metadata.TriCount);
+		}
+		file.write(reinterpret_cast<const char*>(&assetPool.NodeBuffer[metadata.firstNodeIdx]), sizeof(BVHAccel::Node) * metadata.nodeCount);
+		file.write(reinterpret_cast<const char*>(&assetPool.IndexBuffer[metadata.firstIndexIdx]), sizeof(uint32_t) * metadata.indexCount);
+		file.write(reinterpret_cast<const char*>(triangleOrder.data()), sizeof(uint32_t) * triangleOrder.size());
+		if (!file) {
+			file.close();
+			std::filesystem::remove(cachepath);
+			LOG_ENGINE_ERROR("SaveGeometryCache: failed writing {0}", cachepath.string());
+			return false;
+		}
+		return true;
+	}
+
+	bool LoadGeometryCache(const std::filesystem::path& cachepath, const GeometryCacheKey& key, AssetPool& assetPool, MeshMetadata& metadata,
+						   std::vector<uint32_t>& triangleOrder) {
+		std::ifstream file(cachepath, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		GeometryCacheHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		const GeometryCacheHeader expected = MakeGeometryCacheHeader(key);
+		if (!file || std::memcmp(&header, &expected, offsetof(GeometryCacheHeader, triCount)) != 0) {
+			LOG_ENGINE_INFO("LoadGeometryCache: {0} is stale, rebuilding", cachepath.string());
+			return false;
+		}
+
+		const bool indexed = key.meshOptions.indexedVertices;
+		const uintmax_t expectedSize = sizeof(header) + uintmax_t(header.triangleSize) * header.triCount + uintmax_t(sizeof(glm::vec3)) * header.vertexCount +
+			uintmax_t(sizeof(BVHAccel::Node)) * header.nodeCount + uintmax_t(sizeof(uint32_t)) * (header.indexCount + header.triangleOrderCount);
+		std::error_code ec;
+		if (std::filesystem::file_size(cachepath, ec) != expectedSize || ec || (header.triangleOrderCount != 0 && header.triangleOrderCount != header.triCount)) {
+			LOG_ENGINE_WARN("LoadGeometryCache: {0} is truncated or corrupt", cachepath.string());
+			return false;
+		}
+
+		// read each range straight into the end of its pool buffer
+		const size_t firstTriIdx = indexed ? assetPool.FaceBuffer.size() : assetPool.MeshBuffer.size();
+		const size_t firstVertexIdx = assetPool.VertexBuffer.size();
+		const size_t firstNodeIdx = assetPool.NodeBuffer.size();
+		const size_t firstIndexIdx = assetPool.IndexBuffer.size();
+		if (indexed) {
+			assetPool.VertexBuffer.resize(firstVertexIdx + header.vertexCount);
+			assetPool.FaceBuffer.resize(firstTriIdx + header.triCount);
+			file.read(reinterpret_cast<char*>(assetPool.VertexBuffer.data() + firstVertexIdx), sizeof(glm::vec3) * header.vertexCount);
+			file.read(reinterpret_cast<char*>(assetPool.FaceBuffer.data() + firstTriIdx), sizeof(Face) * header.triCount);
+		} else {
+			assetPool.MeshBuffer.resize(firstTriIdx + header.triCount);
+			file.read(reinterpret_cast<char*>(assetPool.MeshBuffer.data() + firstTriIdx), sizeof(Triangle) * header.triCount);
+		}
+		assetPool.NodeBuffer.resize(firstNodeIdx + header.nodeCount);
+		assetPool.IndexBuffer.resize(firstIndexIdx + header.indexCount);
+		file.read(reinterpret_cast<char*>(assetPool.NodeBuffer.data() + firstNodeIdx), sizeof(BVHAccel::Node) * header.nodeCount);
+		file.read(reinterpret_cast<char*>(assetPool.IndexBuffer.data() + firstIndexIdx), sizeof(uint32_t) * header.indexCount);
+		std::vector<uint32_t> cachedTriangleOrder(header.triangleOrderCount);
+		file.read(reinterpret_cast<char*>(cachedTriangleOrder.data()), sizeof(uint32_t) * header.triangleOrderCount);
+		if (!file) {
+			if (indexed) {
+				assetPool.VertexBuffer.resize(firstVertexIdx);
+				assetPool.FaceBuffer.resize(firstTriIdx);
+			} else {
+				assetPool.MeshBuffer.resize(firstTriIdx);
+			}
+			assetPool.NodeBuffer.resize(firstNodeIdx);
+			assetPool.IndexBuffer.resize(firstIndexIdx);
+			LOG_ENGINE_WARN("LoadGeometryCache: failed reading {0}", cachepath.string());
+			return false;
+		}
+
+		metadata.firstTriIdx = static_cast<uint32_t>(firstTriIdx);
+		metadata.TriCount = header.triCount;
+		metadata.firstNodeIdx = static_cast<uint32_t>(firstNodeIdx);
+		metadata.nodeCount = header.nodeCount;
+		metadata.firstIndexIdx = static_cast<uint32_t>(firstIndexIdx);
+		metadata.indexCount = header.indexCount;
+		metadata.indexedVertices = indexed;
+		metadata.precomputedTriangles = (header.flags & GEOMETRY_CACHE_PRECOMPUTED_TRIANGLES) != 0;
+		metadata.firstVertexIdx = indexed ? static_cast<uint32_t>(firstVertexIdx) : 0;
+		metadata.vertexCount = header.vertexCount;
+		// the reorder only fails where spatial splits duplicated references
+		metadata.leafOrdered = (header.flags & GEOMETRY_CACHE_LEAF_ORDERED) && header.indexCount == header.triCount;
+		triangleOrder = std::move(cachedTriangleOrder);
+		return true;
+	}
+
 
     // ASSET MANAGER ---------------------------------------------------------------------------
     AssetManager::AssetManager()
@@ -89,6 +322,26 @@ namespace X3
     }
 
 
+	bool AssetManager::RemoveAsset(LR_GUID guid) {
+		auto it = m_AssetPool->Metadata.find(guid);
+		if (it == m_AssetPool->Metadata.end()) {
+			LOG_ENGINE_WARN("RemoveAsset: no asset with GUID {0}", (uint64_t)guid);
+			return false;
+		}
+
+		// the data stays in place until CompactAssetPool() (or a later load) reuses it, nothing to upload
+		for (const AssetRange& range : GetAssetRanges(guid, *it->second.first)) {
+			m_AssetPool->FreeRange(range.type, range.first, range.count);
+		}
+		m_StaticBatchRanges.erase(guid);
+		m_AssetPool->Metadata.erase(it);
+		m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
+
+		LOG_ENGINE_INFO("RemoveAsset: removed asset with GUID {0}", (uint64_t)guid);
+		return true;
+	}
+
+
 	void AssetManager::SaveAssetPoolToFolder(const std::filesystem::path& folderpath) const {
 		// Delete all existing metafiles which don't have GUID within the asset pool
 		for (const auto& metapath : FindFilesInFolder(folderpath, ASSET_META_FILE_EXTENSION)) {
@@ -100,6 +353,7 @@ namespace X3
 			LR_GUID guid = maybeMetafile->guid;
 			if (m_AssetPool->Metadata.find(guid) == m_AssetPool->Metadata.end()) {
 				std::filesystem::remove(metapath);
+				std::filesystem::remove(AppendExtension(StripExtension(metapath), GEOMETRY_CACHE_FILE_EXTENSION));
 				LOG_ENGINE_INFO("SaveAssetPoolToFolder: removed stale metafile {0}", metapath.string());
 			}
 		}
@@ -107,8 +361,15 @@ namespace X3
 		// Save metafiles for all assets in the asset pool
 		for (const auto& [guid, metadataPair] : m_AssetPool->Metadata) {
 			const auto& [metadata, metadataExtension] = metadataPair;
+			if (auto meshMetadata = std::dynamic_pointer_cast<MeshMetadata>(metadata); meshMetadata && meshMetadata->staticBatch) {
+				continue; // rebuilt from the scene, has no asset file
+			}
 			if (metadataExtension && std::filesystem::exists(metadataExtension->sourcePath)) {
 				AssetMetaFile metafile{ guid, metadataExtension->sourcePath };
+				if (auto meshExtension = std::dynamic_pointer_cast<MeshMetadataExtension>(metadataExtension)) {
+					metafile.bvhOptions = meshExtension->bvhOptions;
+					metafile.meshOptions = meshExtension->meshOptions;
+				}
 
 				// save .lrmeta in the project root next to .lrproj file with filename same as the original asset + .lrmeta extension
 				auto metapath = folderpath / (metadataExtension->sourcePath.filename().string() + ASSET_META_FILE_EXTENSION);
@@ -126,6 +387,7 @@ namespace X3
 
 
 	void AssetManager::LoadAssetPoolFromFolder(const std::filesystem::path& folderpath) {
+		m_GeometryCacheFolder = folderpath;
 		for (const auto& metapath : FindFilesInFolder(folderpath, ASSET_META_FILE_EXTENSION)) {
 			auto maybeMetafile = LoadMetaFile(metapath);
 			if (!maybeMetafile.has_value()) {
@@ -142,7 +404,7 @@ namespace X3
 			}
 
 			// if yes then load the asset from that file
-			if (!LoadAssetFile(sourcePath, maybeMetafile->guid)) {
+			if (!LoadAssetFile(sourcePath, maybeMetafile->guid, maybeMetafile->bvhOptions, maybeMetafile->meshOptions)) {
 				LOG_ENGINE_WARN("LoadAssetPoolFromFolder: failed to load asset {0}", sourcePath.string());
 				continue;
 			}
@@ -152,7 +414,8 @@ namespace X3
 	}
 
 
-	bool AssetManager::LoadAssetFile(const std::filesystem::path& assetpath, LR_GUID guid) {
+	bool AssetManager::LoadAssetFile(const std::filesystem::path& assetpath, LR_GUID guid, const BVHBuildOptions& bvhOptions,
+									 const MeshImportOptions& meshOptions) {
 		if (!std::filesystem::exists(assetpath) || !std::filesystem::is_regular_file(assetpath) || !assetpath.has_extension()) {
 			LOG_ENGINE_ERROR("LoadAssetFile: invalid asset path {0}", assetpath.string());
 			return false;
@@ -163,7 +426,7 @@ namespace X3
 		for (const auto& SUPPORTED_FORMAT : SUPPORTED_MESH_FILE_FORMATS) {
 			if (extension == SUPPORTED_FORMAT) {
 				LOG_ENGINE_INFO("LoadAssetFile: loading mesh {0} for GUID {1}", assetpath.string(), (uint64_t)guid);
-				return LoadMesh(assetpath, guid);
+				return LoadMesh(assetpath, guid, bvhOptions, meshOptions);
 			}
 		}
 		for (const auto& SUPPORTED_FORMAT : SUPPORTED_TEXTURE_FILE_FORMATS) {
@@ -178,7 +441,7 @@ namespace X3
 	}
 
 
-	bool AssetManager::LoadMesh(const std::filesystem::path& assetpath, LR_GUID guid) {
+	bool AssetManager::LoadMesh(const std::filesystem::path& assetpath, LR_GUID guid, const BVHBuildOptions& bvhOptions, const MeshImportOptions& meshOptions) {
 		auto timerStart = std::chrono::high_resolution_clock::now();
 
 		if (!m_AssetPool) {
@@ -186,54 +449,168 @@ namespace X3
 			return false;
 		}
 
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(assetpath.string(), aiProcessPreset_TargetRealtime_MaxQuality);
-		if (!scene) {
-			LOG_ENGINE_CRITICAL("LoadMesh: failed to load assimp scene from {0} (GUID {1})", assetpath.string(), (uint64_t)guid);
-			return false;
-		}
-
-		size_t triCount = 0;
-		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
-			triCount += scene->mMeshes[i]->mNumFaces;
-
 		std::vector<Triangle>& meshBuffer = m_AssetPool->MeshBuffer;
+		std::vector<glm::vec3>& vertexBuffer = m_AssetPool->VertexBuffer;
+		std::vector<Face>& faceBuffer = m_AssetPool->FaceBuffer;
 
 		auto metadata = std::make_shared<MeshMetadata>();
-		metadata->firstTriIdx = meshBuffer.size();
-		metadata->TriCount = triCount;
-
 		auto metadataExtension = std::make_shared<MeshMetadataExtension>();
 		metadataExtension->sourcePath = assetpath;
 		metadataExtension->fileSizeInBytes = std::filesystem::file_size(assetpath);
+		metadataExtension->bvhOptions = bvhOptions;
+		metadataExtension->meshOptions = meshOptions;
 
-		meshBuffer.reserve(meshBuffer.size() + triCount);
+		// try the geometry cache first, it skips both Assimp and the BVH build
+		std::filesystem::path cachepath;
+		GeometryCacheKey cacheKey{ 0, metadataExtension->fileSizeInBytes, bvhOptions, meshOptions };
+		if (!m_GeometryCacheFolder.empty()) {
+			if (auto sourceHash = HashFileContents(assetpath)) {
+				cacheKey.sourceHash = metadataExtension->sourceHash = *sourceHash;
+				cachepath = m_GeometryCacheFolder / (assetpath.filename().string() + GEOMETRY_CACHE_FILE_EXTENSION);
+			}
+		}
+		const bool loadedFromCache = !cachepath.empty() && LoadGeometryCache(cachepath, cacheKey, *m_AssetPool, *metadata, metadataExtension->triangleOrder);
+
+		if (!loadedFromCache) {
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(assetpath.string(), aiProcessPreset_TargetRealtime_MaxQuality);
+			if (!scene) {
+				LOG_ENGINE_CRITICAL("LoadMesh: failed to load assimp scene from {0} (GUID {1})", assetpath.string(), (uint64_t)guid);
+				return false;
+			}
+
+			size_t triCount = 0;
+			for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+				triCount += scene->mMeshes[i]->mNumFaces;
 
-		for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
-			const aiMesh* subMesh = scene->mMeshes[i];
-			const aiVector3D* verts = subMesh->mVertices;
+			metadata->indexedVertices = meshOptions.indexedVertices;
+			if (meshOptions.indexedVertices) {
+				metadata->firstTriIdx = faceBuffer.size();
+				metadata->firstVertexIdx = vertexBuffer.size();
+				faceBuffer.reserve(faceBuffer.size() + triCount);
 
-			for (unsigned int j = 0; j < subMesh->mNumFaces; ++j) {
-				const aiFace& face = subMesh->mFaces[j];
-				if (face.mNumIndices != 3) continue;
+				// Assimp splits vertices along normal & uv seams (and per sub mesh), only the positions matter here.
+				// +0.0f folds -0 into 0 so equal positions hash equally
+				struct PositionHash {
+					size_t operator()(const glm::vec3& p) const {
+						uint32_t bits[3];
+						std::memcpy(bits, &p, sizeof(bits));
+						return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+					}
+				};
+				std::unordered_map<glm::vec3, uint32_t, PositionHash> weldedVertices;
+				auto weld = [&](const aiVector3D& v) -> uint32_t {
+					const glm::vec3 position(v.x + 0.0f, v.y + 0.0f, v.z + 0.0f);
+					auto [it, inserted] = weldedVertices.try_emplace(position, static_cast<uint32_t>(vertexBuffer.size() - metadata->firstVertexIdx));
+					if (inserted) {
+						vertexBuffer.push_back(position);
+					}
+					return it->second;
+				};
 
-				const auto& idx = face.mIndices;
-				meshBuffer.emplace_back(Triangle({
-					glm::vec4(verts[idx[0]].x, verts[idx[0]].y, verts[idx[0]].z, 0.0f),
-					glm::vec4(verts[idx[1]].x, verts[idx[1]].y, verts[idx[1]].z, 0.0f),
-					glm::vec4(verts[idx[2]].x, verts[idx[2]].y, verts[idx[2]].z, 0.0f)
-				}));
+				for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+					const aiMesh* subMesh = scene->mMeshes[i];
+					const aiVector3D* verts = subMesh->mVertices;
+
+					for (unsigned int j = 0; j < subMesh->mNumFaces; ++j) {
+						const aiFace& face = subMesh->mFaces[j];
+						if (face.mNumIndices != 3) continue;
+
+						const auto& idx = face.mIndices;
+						faceBuffer.push_back({ weld(verts[idx[0]]), weld(verts[idx[1]]), weld(verts[idx[2]]) });
+					}
+				}
+				metadata->TriCount = faceBuffer.size() - metadata->firstTriIdx;
+				metadata->vertexCount = vertexBuffer.size() - metadata->firstVertexIdx;
+			} else {
+				metadata->precomputedTriangles = meshOptions.precomputedTriangles;
+				metadata->firstTriIdx = meshBuffer.size();
+				meshBuffer.reserve(meshBuffer.size() + triCount);
+
+				for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+					const aiMesh* subMesh = scene->mMeshes[i];
+					const aiVector3D* verts = subMesh->mVertices;
+
+					for (unsigned int j = 0; j < subMesh->mNumFaces; ++j) {
+						const aiFace& face = subMesh->mFaces[j];
+						if (face.mNumIndices != 3) continue;
+
+						const auto& idx = face.mIndices;
+						const Triangle tri = {
+							glm::vec4(verts[idx[0]].x, verts[idx[0]].y, verts[idx[0]].z, 0.0f),
+							glm::vec4(verts[idx[1]].x, verts[idx[1]].y, verts[idx[1]].z, 0.0f),
+							glm::vec4(verts[idx[2]].x, verts[idx[2]].y, verts[idx[2]].z, 0.0f)
+						};
+						meshBuffer.push_back(meshOptions.precomputedTriangles ? ToPrecomputedTriangle(tri) : tri);
+					}
+				}
+				metadata->TriCount = meshBuffer.size() - metadata->firstTriIdx; // points & lines were skipped
 			}
-		}
 
-		m_AssetPool->MarkUpdated(AssetPool::AssetType::MeshBuffer);
+			// Build BVH - large meshes get an LBVH now and their SAH BVH once the background build is done
+			const bool buildInBackground = metadata->TriCount >= BACKGROUND_BVH_MIN_TRIS;
+			auto bvhTimerStart = std::chrono::high_resolution_clock::now();
+			BVHAccel bvh(m_AssetPool->GetTriangles(*metadata), metadata->TriCount);
+			if (buildInBackground) {
+				bvh.BuildLinear(m_AssetPool->NodeBuffer, m_AssetPool->IndexBuffer, metadata->firstNodeIdx, metadata->nodeCount,
+								metadata->firstIndexIdx, metadata->indexCount);
+			} else {
+				bvh.Build(m_AssetPool->NodeBuffer, m_AssetPool->IndexBuffer, metadata->firstNodeIdx, metadata->nodeCount,
+						  metadata->firstIndexIdx, metadata->indexCount, bvhOptions);
+			}
+			double bvhBuildTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bvhTimerStart).count();
+			LOG_ENGINE_INFO("LoadMesh: built {0}BVH with {1} nodes, {2} triangle references in {3:.2f} ms ({4:.2f} Mtris/s)",
+				buildInBackground ? "linear " : bvhOptions.spatialSplits ? "spatial split " : "", metadata->nodeCount, metadata->indexCount,
+				bvhBuildTimeMs, metadata->TriCount / std::max(bvhBuildTimeMs, 1e-3) / 1000.0);
+			CommitMeshRanges(*metadata);
 
-		// Build BVH
-		BVHAccel bvh(meshBuffer, metadata->firstTriIdx, metadata->TriCount);
-		bvh.Build(m_AssetPool->NodeBuffer, m_AssetPool->IndexBuffer, metadata->firstNodeIdx, metadata->nodeCount);
+			BVHQualityReport& quality = metadataExtension->bvhQuality;
+			quality.builder = buildInBackground ? "LBVH" : BVHBuilderName(bvhOptions);
+			quality.setupTimeMs = bvh.GetSetupTimeMs();
+			quality.buildTimeMs = bvh.GetBuildTimeMs();
+			quality.optimizeTimeMs = bvh.GetOptimizeTimeMs();
+			auto reorderTimerStart = std::chrono::high_resolution_clock::now();
+			metadata->leafOrdered = bvhOptions.leafOrderedTriangles && ReorderMeshToLeafOrder(*metadata, *metadataExtension);
+			quality.leafOrderTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - reorderTimerStart).count();
+
+			if (buildInBackground) {
+				// copies the triangles as stored (possibly leaf ordered), so the build's indices match the pool
+				std::vector<Triangle> triangles;
+				std::vector<glm::vec3> vertices;
+				std::vector<Face> faces;
+				if (metadata->indexedVertices) {
+					vertices.assign(vertexBuffer.begin() + metadata->firstVertexIdx, vertexBuffer.begin() + metadata->firstVertexIdx + metadata->vertexCount);
+					faces.assign(faceBuffer.begin() + metadata->firstTriIdx, faceBuffer.begin() + metadata->firstTriIdx + metadata->TriCount);
+				} else {
+					triangles.assign(meshBuffer.begin() + metadata->firstTriIdx, meshBuffer.begin() + metadata->firstTriIdx + metadata->TriCount);
+				}
+				auto result = std::async(std::launch::async, [triangles = std::move(triangles), vertices = std::move(vertices), faces = std::move(faces),
+															  triCount = metadata->TriCount, indexed = metadata->indexedVertices,
+															  precomputed = metadata->precomputedTriangles, bvhOptions]() {
+					BackgroundBVHBuild build;
+					uint32_t firstNodeIdx, nodeCount, firstIndexIdx, indexCount;
+					BVHAccel bvh(indexed ? BVHAccel::TriangleView(vertices, 0, faces, 0) : BVHAccel::TriangleView(triangles, 0, precomputed), triCount);
+					bvh.Build(build.nodes, build.indices, firstNodeIdx, nodeCount, firstIndexIdx, indexCount, bvhOptions);
+					build.setupTimeMs = bvh.GetSetupTimeMs();
+					build.buildTimeMs = bvh.GetBuildTimeMs();
+					build.optimizeTimeMs = bvh.GetOptimizeTimeMs();
+					return build;
+				});
+				m_PendingBVHBuilds.push_back({ guid, metadataExtension->bvhGeneration, cacheKey, cachepath, std::move(result) });
+			}
+			else if (!cachepath.empty() && SaveGeometryCache(cachepath, cacheKey, *m_AssetPool, *metadata, metadataExtension->triangleOrder)) {
+				LOG_ENGINE_INFO("LoadMesh: wrote geometry cache {0}", cachepath.string());
+			}
+		}
+		else {
+			CommitMeshRanges(*metadata);
+			metadataExtension->bvhQuality.builder = BVHBuilderName(bvhOptions); // only finished SAH builds are cached
+			metadataExtension->bvhQuality.fromGeometryCache = true;
+		}
 
-		m_AssetPool->MarkUpdated(AssetPool::AssetType::NodeBuffer);
-		m_AssetPool->MarkUpdated(AssetPool::AssetType::IndexBuffer);
+		metadataExtension->bvhBuildSAHInflation = BVHAccel::ComputeSAHInflation(m_AssetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount,
+			m_AssetPool->IndexBuffer, metadata->firstIndexIdx, m_AssetPool->GetTriangles(*metadata));
+		BVHAccel::Analyze(m_AssetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount, metadataExtension->bvhQuality);
 
 		double loadTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - timerStart).count();
 		metadataExtension->loadTimeMs = loadTimeMs;
@@ -241,8 +618,473 @@ namespace X3
 		m_AssetPool->Metadata[guid] = { metadata, metadataExtension };
 		m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
 
-		LOG_ENGINE_INFO("LoadMesh: loaded {0} triangles from {1} (GUID {2}) in {3:.2f} ms", 
-			triCount, assetpath.string(), (uint64_t)guid, loadTimeMs);
+		LOG_ENGINE_INFO("LoadMesh: loaded {0} triangles{1} from {2} (GUID {3}) in {4:.2f} ms{5}", metadata->TriCount,
+			metadata->indexedVertices ? fmt::format(" over {0} vertices", metadata->vertexCount) : "",
+			assetpath.string(), (uint64_t)guid, loadTimeMs, loadedFromCache ? " (geometry cache)" : "");
+		return true;
+	}
+
+
+	bool AssetManager::RebuildMeshBVH(LR_GUID guid, const BVHBuildOptions& options) {
+		auto it = m_AssetPool->Metadata.find(guid);
+		if (it == m_AssetPool->Metadata.end()) {
+			LOG_ENGINE_WARN("RebuildMeshBVH: no asset with GUID {0}", (uint64_t)guid);
+			return false;
+		}
+
+		auto metadata = std::dynamic_pointer_cast<MeshMetadata>(it->second.first);
+		auto metadataExtension = std::dynamic_pointer_cast<MeshMetadataExtension>(it->second.second);
+		if (!metadata || !metadataExtension) {
+			LOG_ENGINE_WARN("RebuildMeshBVH: asset with GUID {0} is not a mesh", (uint64_t)guid);
+			return false;
+		}
+
+		// build into a copy, the renderer keeps reading the current metadata until it is swapped
+		auto rebuiltMetadata = std::make_shared<MeshMetadata>(*metadata);
+		auto bvhTimerStart = std::chrono::high_resolution_clock::now();
+		BVHAccel bvh(m_AssetPool->GetTriangles(*rebuiltMetadata), rebuiltMetadata->TriCount);
+		bvh.Build(m_AssetPool->NodeBuffer, m_AssetPool->IndexBuffer, rebuiltMetadata->firstNodeIdx, rebuiltMetadata->nodeCount,
+				  rebuiltMetadata->firstIndexIdx, rebuiltMetadata->indexCount, options);
+		double bvhBuildTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bvhTimerStart).count();
+		rebuiltMetadata->firstNodeIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::NodeBuffer, m_AssetPool->NodeBuffer,
+																		 rebuiltMetadata->firstNodeIdx, rebuiltMetadata->nodeCount);
+		rebuiltMetadata->firstIndexIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::IndexBuffer, m_AssetPool->IndexBuffer,
+																		  rebuiltMetadata->firstIndexIdx, rebuiltMetadata->indexCount);
+
+		// reordering in place is fine, the old nodes & indices aren't referenced once the metadata is swapped
+		auto reorderTimerStart = std::chrono::high_resolution_clock::now();
+		rebuiltMetadata->leafOrdered = options.leafOrderedTriangles && ReorderMeshToLeafOrder(*rebuiltMetadata, *metadataExtension);
+		const double leafOrderTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - reorderTimerStart).count();
+
+		metadataExtension->bvhOptions = options;
+		metadataExtension->bvhGeneration++;
+		metadataExtension->bvhBuildSAHInflation = BVHAccel::ComputeSAHInflation(m_AssetPool->NodeBuffer, rebuiltMetadata->firstNodeIdx, rebuiltMetadata->nodeCount,
+			m_AssetPool->IndexBuffer, rebuiltMetadata->firstIndexIdx, m_AssetPool->GetTriangles(*rebuiltMetadata));
+		metadataExtension->bvhQuality = { .builder = BVHBuilderName(options), .setupTimeMs = bvh.GetSetupTimeMs(), .buildTimeMs = bvh.GetBuildTimeMs(),
+										  .optimizeTimeMs = bvh.GetOptimizeTimeMs(), .leafOrderTimeMs = leafOrderTimeMs };
+		BVHAccel::Analyze(m_AssetPool->NodeBuffer, rebuiltMetadata->firstNodeIdx, rebuiltMetadata->nodeCount, metadataExtension->bvhQuality);
+		it->second.first = rebuiltMetadata;
+		m_AssetPool->FreeRange(AssetPool::AssetType::NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount);
+		m_AssetPool->FreeRange(AssetPool::AssetType::IndexBuffer, metadata->firstIndexIdx, metadata->indexCount);
+		m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
+
+		LOG_ENGINE_INFO("RebuildMeshBVH: rebuilt {0}BVH of GUID {1} with {2} nodes, {3} triangle references in {4:.2f} ms",
+			options.spatialSplits ? "spatial split " : "", (uint64_t)guid, rebuiltMetadata->nodeCount, rebuiltMetadata->indexCount, bvhBuildTimeMs);
+		return true;
+	}
+
+
+	bool AssetManager::ReorderMeshToLeafOrder(const MeshMetadata& metadata, MeshMetadataExtension& metadataExtension) {
+		if (metadata.indexedVertices) {
+			if (!BVHAccel::ReorderTrianglesToLeafOrder(m_AssetPool->FaceBuffer, metadata.firstTriIdx, metadata.TriCount,
+													   m_AssetPool->IndexBuffer, metadata.firstIndexIdx, metadata.indexCount, &metadataExtension.triangleOrder)) {
+				return false;
+			}
+			m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::FaceBuffer, metadata.firstTriIdx, metadata.TriCount);
+		} else {
+			if (!BVHAccel::ReorderTrianglesToLeafOrder(m_AssetPool->MeshBuffer, metadata.firstTriIdx, metadata.TriCount,
+													   m_AssetPool->IndexBuffer, metadata.firstIndexIdx, metadata.indexCount, &metadataExtension.triangleOrder)) {
+				return false;
+			}
+			m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::MeshBuffer, metadata.firstTriIdx, metadata.TriCount);
+		}
+		return true;
+	}
+
+
+	void AssetManager::CommitMeshRanges(MeshMetadata& metadata) {
+		if (metadata.indexedVertices) {
+			metadata.firstVertexIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::VertexBuffer, m_AssetPool->VertexBuffer,
+																	   metadata.firstVertexIdx, metadata.vertexCount);
+			metadata.firstTriIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::FaceBuffer, m_AssetPool->FaceBuffer,
+																	metadata.firstTriIdx, metadata.TriCount);
+		} else {
+			metadata.firstTriIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::MeshBuffer, m_AssetPool->MeshBuffer,
+																	metadata.firstTriIdx, metadata.TriCount);
+		}
+		metadata.firstNodeIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::NodeBuffer, m_AssetPool->NodeBuffer,
+																 metadata.firstNodeIdx, metadata.nodeCount);
+		metadata.firstIndexIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::IndexBuffer, m_AssetPool->IndexBuffer,
+																  metadata.firstIndexIdx, metadata.indexCount);
+	}
+
+
+	std::optional<float> AssetManager::UpdateMeshTriangles(LR_GUID guid, const std::vector<Triangle>& triangles) {
+		auto it = m_AssetPool->Metadata.find(guid);
+		if (it == m_AssetPool->Metadata.end()) {
+			LOG_ENGINE_WARN("UpdateMeshTriangles: no asset with GUID {0}", (uint64_t)guid);
+			return std::nullopt;
+		}
+
+		auto metadata = std::dynamic_pointer_cast<MeshMetadata>(it->second.first);
+		auto metadataExtension = std::dynamic_pointer_cast<MeshMetadataExtension>(it->second.second);
+		if (!metadata || !metadataExtension) {
+			LOG_ENGINE_WARN("UpdateMeshTriangles: asset with GUID {0} is not a mesh", (uint64_t)guid);
+			return std::nullopt;
+		}
+		if (metadata->indexedVertices) {
+			LOG_ENGINE_WARN("UpdateMeshTriangles: GUID {0} is an indexed mesh, its triangles share vertices", (uint64_t)guid);
+			return std::nullopt;
+		}
+		if (triangles.size() != metadata->TriCount) {
+			LOG_ENGINE_WARN("UpdateMeshTriangles: expected {0} triangles for GUID {1}, got {2}",
+				metadata->TriCount, (uint64_t)guid, triangles.size());
+			return std::nullopt;
+		}
+
+		// source order -> the slots leaf ordering moved the triangles to
+		const std::vector<uint32_t>& triangleOrder = metadataExtension->triangleOrder;
+		Triangle* meshTriangles = m_AssetPool->MeshBuffer.data() + metadata->firstTriIdx;
+		for (uint32_t i = 0; i < metadata->TriCount; i++) {
+			const uint32_t slot = triangleOrder.empty() ? i : triangleOrder[i];
+			meshTriangles[slot] = metadata->precomputedTriangles ? ToPrecomputedTriangle(triangles[i]) : triangles[i];
+		}
+		metadataExtension->bvhGeneration++; // a pending background build is for the old triangles
+		float refitInflation = BVHAccel::Refit(m_AssetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount,
+											 m_AssetPool->IndexBuffer, metadata->firstIndexIdx, m_AssetPool->GetTriangles(*metadata));
+		BVHAccel::Analyze(m_AssetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount, metadataExtension->bvhQuality);
+
+		m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::MeshBuffer, metadata->firstTriIdx, metadata->TriCount);
+		m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount);
+
+		const float buildInflation = metadataExtension->bvhBuildSAHInflation;
+		return (buildInflation > 0.0f) ? refitInflation / buildInflation : 1.0f;
+	}
+
+
+	bool AssetManager::BuildStaticBatch(LR_GUID guid, const std::vector<StaticBatchInstance>& instances) {
+		auto timerStart = std::chrono::high_resolution_clock::now();
+
+		// bake the instances into world space, the material slot rides along in v0.w
+		std::vector<Triangle> triangles;
+		for (const StaticBatchInstance& instance : instances) {
+			auto metadata = m_AssetPool->find<MeshMetadata>(instance.meshGuid);
+			if (!metadata || metadata->staticBatch) {
+				continue;
+			}
+			const BVHAccel::TriangleView view = m_AssetPool->GetTriangles(*metadata);
+			const float materialSlot = static_cast<float>(instance.materialSlot);
+			// mirroring transforms flip the winding, swapping two vertices keeps the same side front facing
+			const bool mirrored = glm::determinant(glm::mat3(instance.transform)) < 0.0f;
+			triangles.reserve(triangles.size() + metadata->TriCount);
+			for (uint32_t i = 0; i < metadata->TriCount; i++) {
+				glm::vec3 v0, v1, v2;
+				view.Fetch(i, v0, v1, v2);
+				if (mirrored) {
+					std::swap(v1, v2);
+				}
+				triangles.push_back({
+					glm::vec4(glm::vec3(instance.transform * glm::vec4(v0, 1.0f)), materialSlot),
+					glm::vec4(glm::vec3(instance.transform * glm::vec4(v1, 1.0f)), 0.0f),
+					glm::vec4(glm::vec3(instance.transform * glm::vec4(v2, 1.0f)), 0.0f)
+				});
+			}
+		}
+
+		if (triangles.empty()) {
+			if (m_AssetPool->Metadata.contains(guid)) {
+				RemoveAsset(guid);
+			}
+			return false;
+		}
+
+		// no spatial splits, so the ranges are bounded by the triangle count and rebuilds fit into the previous ones
+		const uint32_t triCount = static_cast<uint32_t>(triangles.size());
+		BVHBuildOptions options;
+		options.spatialSplits = false;
+		options.leafOrderedTriangles = true;
+
+		std::vector<BVHAccel::Node> nodes;
+		std::vector<uint32_t> indices;
+		uint32_t firstNodeIdx, nodeCount, firstIndexIdx, indexCount;
+		BVHAccel bvh(BVHAccel::TriangleView(triangles, 0), triCount);
+		bvh.Build(nodes, indices, firstNodeIdx, nodeCount, firstIndexIdx, indexCount, options);
+		auto reorderTimerStart = std::chrono::high_resolution_clock::now();
+		BVHAccel::ReorderTrianglesToLeafOrder(triangles, 0, triCount, indices, 0, indexCount);
+		const double leafOrderTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - reorderTimerStart).count();
+
+		// child & leaf indices are relative to their range, so the build copies over as is
+		StaticBatchRanges& ranges = m_StaticBatchRanges[guid];
+		const bool grown = triCount > ranges.capacity;
+		if (grown) { // the previous ranges go back to the pool, the new ones are committed like appended mesh ranges
+			if (ranges.capacity != 0) {
+				m_AssetPool->FreeRange(AssetPool::AssetType::MeshBuffer, ranges.firstTriIdx, ranges.capacity);
+				m_AssetPool->FreeRange(AssetPool::AssetType::NodeBuffer, ranges.firstNodeIdx, 2 * ranges.capacity - 1);
+				m_AssetPool->FreeRange(AssetPool::AssetType::IndexBuffer, ranges.firstIndexIdx, ranges.capacity);
+			}
+			auto appendRange = [this](AssetPool::AssetType type, auto& buffer, const auto& data, uint32_t capacity) {
+				const uint32_t first = static_cast<uint32_t>(buffer.size());
+				buffer.insert(buffer.end(), data.begin(), data.end());
+				buffer.resize(first + capacity);
+				return m_AssetPool->CommitAppendedRange(type, buffer, first, capacity);
+			};
+			ranges.capacity = triCount;
+			ranges.firstTriIdx = appendRange(AssetPool::AssetType::MeshBuffer, m_AssetPool->MeshBuffer, triangles, triCount);
+			ranges.firstNodeIdx = appendRange(AssetPool::AssetType::NodeBuffer, m_AssetPool->NodeBuffer, nodes, 2 * triCount - 1);
+			ranges.firstIndexIdx = appendRange(AssetPool::AssetType::IndexBuffer, m_AssetPool->IndexBuffer, indices, triCount);
+		} else {
+			std::copy(triangles.begin(), triangles.end(), m_AssetPool->MeshBuffer.begin() + ranges.firstTriIdx);
+			std::copy(nodes.begin(), nodes.end(), m_AssetPool->NodeBuffer.begin() + ranges.firstNodeIdx);
+			std::copy(indices.begin(), indices.end(), m_AssetPool->IndexBuffer.begin() + ranges.firstIndexIdx);
+			m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::MeshBuffer, ranges.firstTriIdx, triCount);
+			m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::NodeBuffer, ranges.firstNodeIdx, nodeCount);
+			m_AssetPool->MarkRangeUpdated(AssetPool::AssetType::IndexBuffer, ranges.firstIndexIdx, indexCount);
+		}
+
+		auto metadata = std::make_shared<MeshMetadata>();
+		metadata->firstTriIdx = ranges.firstTriIdx;
+		metadata->TriCount = triCount;
+		metadata->firstNodeIdx = ranges.firstNodeIdx;
+		metadata->nodeCount = nodeCount;
+		metadata->firstIndexIdx = ranges.firstIndexIdx;
+		metadata->indexCount = indexCount;
+		metadata->leafOrdered = true;
+		metadata->staticBatch = true;
+
+		auto metadataExtension = std::make_shared<MeshMetadataExtension>();
+		metadataExtension->bvhOptions = options;
+		metadataExtension->bvhBuildSAHInflation = BVHAccel::ComputeSAHInflation(m_AssetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount,
+			m_AssetPool->IndexBuffer, metadata->firstIndexIdx, m_AssetPool->GetTriangles(*metadata));
+		metadataExtension->bvhQuality = { .builder = BVHBuilderName(options), .setupTimeMs = bvh.GetSetupTimeMs(), .buildTimeMs = bvh.GetBuildTimeMs(),
+										  .optimizeTimeMs = bvh.GetOptimizeTimeMs(), .leafOrderTimeMs = leafOrderTimeMs };
+		BVHAccel::Analyze(m_AssetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount, metadataExtension->bvhQuality);
+
+		double loadTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - timerStart).count();
+		metadataExtension->loadTimeMs = loadTimeMs;
+		m_AssetPool->Metadata[guid] = { metadata, metadataExtension };
+		m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
+
+		LOG_ENGINE_INFO("BuildStaticBatch: merged {0} instances into {1} world space triangles, {2} nodes in {3:.2f} ms{4}",
+			instances.size(), triCount, nodeCount, loadTimeMs, grown ? "" : " (ranges reused)");
+		return true;
+	}
+
+
+	uint32_t AssetManager::ApplyFinishedBVHBuilds() {
+		uint32_t appliedCount = 0;
+		for (auto pending = m_PendingBVHBuilds.begin(); pending != m_PendingBVHBuilds.end();) {
+			if (pending->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++pending;
+				continue;
+			}
+
+			BackgroundBVHBuild build = pending->result.get();
+			auto it = m_AssetPool->Metadata.find(pending->guid);
+			auto metadata = (it != m_AssetPool->Metadata.end()) ? std::dynamic_pointer_cast<MeshMetadata>(it->second.first) : nullptr;
+			auto metadataExtension = (it != m_AssetPool->Metadata.end()) ? std::dynamic_pointer_cast<MeshMetadataExtension>(it->second.second) : nullptr;
+			if (!metadata || !metadataExtension || metadataExtension->bvhGeneration != pending->bvhGeneration) {
+				LOG_ENGINE_INFO("ApplyFinishedBVHBuilds: dropped outdated background BVH of GUID {0}", (uint64_t)pending->guid);
+				pending = m_PendingBVHBuilds.erase(pending);
+				continue;
+			}
+
+			// append & commit like RebuildMeshBVH(), ranges are relative so the nodes & indices copy over unchanged
+			auto upgradedMetadata = std::make_shared<MeshMetadata>(*metadata);
+			upgradedMetadata->nodeCount = build.nodes.size();
+			upgradedMetadata->indexCount = build.indices.size();
+			const uint32_t appendedNodeIdx = m_AssetPool->NodeBuffer.size();
+			const uint32_t appendedIndexIdx = m_AssetPool->IndexBuffer.size();
+			m_AssetPool->NodeBuffer.insert(m_AssetPool->NodeBuffer.end(), build.nodes.begin(), build.nodes.end());
+			m_AssetPool->IndexBuffer.insert(m_AssetPool->IndexBuffer.end(), build.indices.begin(), build.indices.end());
+			upgradedMetadata->firstNodeIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::NodeBuffer, m_AssetPool->NodeBuffer,
+																			  appendedNodeIdx, upgradedMetadata->nodeCount);
+			upgradedMetadata->firstIndexIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::IndexBuffer, m_AssetPool->IndexBuffer,
+																			   appendedIndexIdx, upgradedMetadata->indexCount);
+			auto reorderTimerStart = std::chrono::high_resolution_clock::now();
+			upgradedMetadata->leafOrdered = metadataExtension->bvhOptions.leafOrderedTriangles && ReorderMeshToLeafOrder(*upgradedMetadata, *metadataExtension);
+			const double leafOrderTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - reorderTimerStart).count();
+
+			metadataExtension->bvhGeneration++;
+			metadataExtension->bvhBuildSAHInflation = BVHAccel::ComputeSAHInflation(m_AssetPool->NodeBuffer, upgradedMetadata->firstNodeIdx, upgradedMetadata->nodeCount,
+				m_AssetPool->IndexBuffer, upgradedMetadata->firstIndexIdx, m_AssetPool->GetTriangles(*upgradedMetadata));
+			metadataExtension->bvhQuality = { .builder = BVHBuilderName(metadataExtension->bvhOptions), .setupTimeMs = build.setupTimeMs,
+											  .buildTimeMs = build.buildTimeMs, .optimizeTimeMs = build.optimizeTimeMs, .leafOrderTimeMs = leafOrderTimeMs };
+			BVHAccel::Analyze(m_AssetPool->NodeBuffer, upgradedMetadata->firstNodeIdx, upgradedMetadata->nodeCount, metadataExtension->bvhQuality);
+			it->second.first = upgradedMetadata;
+			m_AssetPool->FreeRange(AssetPool::AssetType::NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount);
+			m_AssetPool->FreeRange(AssetPool::AssetType::IndexBuffer, metadata->firstIndexIdx, metadata->indexCount);
+			m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
+			appliedCount++;
+
+			LOG_ENGINE_INFO("ApplyFinishedBVHBuilds: swapped in {0}BVH of GUID {1} with {2} nodes, {3} triangle references (built in {4:.2f} ms)",
+				metadataExtension->bvhOptions.spatialSplits ? "spatial split " : "", (uint64_t)pending->guid,
+				upgradedMetadata->nodeCount, upgradedMetadata->indexCount, build.setupTimeMs + build.buildTimeMs + build.optimizeTimeMs);
+
+			if (!pending->cachepath.empty() && SaveGeometryCache(pending->cachepath, pending->cacheKey, *m_AssetPool, *upgradedMetadata, metadataExtension->triangleOrder)) {
+				LOG_ENGINE_INFO("ApplyFinishedBVHBuilds: wrote geometry cache {0}", pending->cachepath.string());
+			}
+			pending = m_PendingBVHBuilds.erase(pending);
+		}
+		return appliedCount;
+	}
+
+
+	size_t AssetManager::CompactAssetPool(size_t maxMovedBytes) {
+		size_t movedBytes = 0;
+		uint32_t movedRanges = 0;
+
+		// points the owner's metadata (a copy, swapped in) at the range's new place
+		auto remap = [this](LR_GUID guid, AssetPool::AssetType type, uint32_t newFirst) {
+			std::shared_ptr<Metadata>& entry = m_AssetPool->Metadata[guid].first;
+			if (auto texture = std::dynamic_pointer_cast<TextureMetadata>(entry)) {
+				auto moved = std::make_shared<TextureMetadata>(*texture);
+				moved->texStartIdx = newFirst;
+				entry = moved;
+				return;
+			}
+			auto moved = std::make_shared<MeshMetadata>(*std::dynamic_pointer_cast<MeshMetadata>(entry));
+			switch (type) {
+				case AssetPool::AssetType::MeshBuffer:
+				case AssetPool::AssetType::FaceBuffer: moved->firstTriIdx = newFirst; break;
+				case AssetPool::AssetType::VertexBuffer: moved->firstVertexIdx = newFirst; break;
+				case AssetPool::AssetType::NodeBuffer: moved->firstNodeIdx = newFirst; break;
+				case AssetPool::AssetType::IndexBuffer: moved->firstIndexIdx = newFirst; break;
+				default: break;
+			}
+			if (auto batch = m_StaticBatchRanges.find(guid); batch != m_StaticBatchRanges.end()) {
+				batch->second.firstTriIdx = moved->firstTriIdx;
+				batch->second.firstNodeIdx = moved->firstNodeIdx;
+				batch->second.firstIndexIdx = moved->firstIndexIdx;
+			}
+			entry = moved;
+		};
+
+		auto compact = [&](AssetPool::AssetType type, auto& buffer) {
+			RangeAllocator& freeRanges = m_AssetPool->GetFreeRanges(type);
+			while (auto hole = freeRanges.GetFirstFreeRange()) {
+				const uint32_t holeEnd = hole->first + hole->count;
+				if (holeEnd >= buffer.size()) { // only the free tail is left
+					if (static_cast<size_t>(hole->count) * 4 >= buffer.size()) {
+						buffer.resize(hole->first);
+						buffer.shrink_to_fit();
+						freeRanges.Truncate(hole->first);
+						m_AssetPool->MarkUpdated(type);
+					}
+					return;
+				}
+				if (movedRanges != 0 && movedBytes >= maxMovedBytes) {
+					return;
+				}
+
+				// the range right behind the hole slides down, its old place merges with whatever is free after it
+				std::optional<std::pair<LR_GUID, AssetRange>> owner;
+				for (const auto& [guid, metadataPair] : m_AssetPool->Metadata) {
+					for (const AssetRange& range : GetAssetRanges(guid, *metadataPair.first)) {
+						if (range.type == type && range.first == holeEnd) {
+							owner.emplace(guid, range);
+						}
+					}
+				}
+				if (!owner) {
+					LOG_ENGINE_ERROR("CompactAssetPool: no asset owns the range at {0}, leaving the hole before it", holeEnd);
+					freeRanges.Claim(hole->first, hole->count);
+					continue;
+				}
+				const auto& [guid, range] = *owner;
+				std::copy(buffer.begin() + range.first, buffer.begin() + range.first + range.count, buffer.begin() + hole->first);
+				freeRanges.Free(range.first, range.count);
+				freeRanges.Claim(hole->first, range.count);
+				remap(guid, type, hole->first);
+				m_AssetPool->MarkRangeMoved(type, range.first, hole->first, range.count);
+				movedBytes += sizeof(buffer[0]) * range.count;
+				movedRanges++;
+			}
+		};
+		compact(AssetPool::AssetType::MeshBuffer, m_AssetPool->MeshBuffer);
+		compact(AssetPool::AssetType::VertexBuffer, m_AssetPool->VertexBuffer);
+		compact(AssetPool::AssetType::FaceBuffer, m_AssetPool->FaceBuffer);
+		compact(AssetPool::AssetType::NodeBuffer, m_AssetPool->NodeBuffer);
+		compact(AssetPool::AssetType::IndexBuffer, m_AssetPool->IndexBuffer);
+		compact(AssetPool::AssetType::TextureBuffer, m_AssetPool->TextureBuffer);
+
+		if (movedRanges != 0) {
+			m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
+			LOG_ENGINE_TRACE("CompactAssetPool: moved {0} ranges ({1} bytes)", movedRanges, movedBytes);
+		}
+		return movedBytes;
+	}
+
+
+	std::vector<AssetManager::AssetRange> AssetManager::GetAssetRanges(LR_GUID guid, const Metadata& metadata) const {
+		std::vector<AssetRange> ranges;
+		if (auto texture = dynamic_cast<const TextureMetadata*>(&metadata)) {
+			ranges.push_back({ AssetPool::AssetType::TextureBuffer, texture->texStartIdx,
+							   static_cast<uint32_t>(texture->width * texture->height * texture->channels) });
+		}
+		else if (auto mesh = dynamic_cast<const MeshMetadata*>(&metadata)) {
+			if (mesh->staticBatch) {
+				if (auto batch = m_StaticBatchRanges.find(guid); batch != m_StaticBatchRanges.end()) {
+					const StaticBatchRanges& reserved = batch->second;
+					ranges.push_back({ AssetPool::AssetType::MeshBuffer, reserved.firstTriIdx, reserved.capacity });
+					ranges.push_back({ AssetPool::AssetType::NodeBuffer, reserved.firstNodeIdx, 2 * reserved.capacity - 1 });
+					ranges.push_back({ AssetPool::AssetType::IndexBuffer, reserved.firstIndexIdx, reserved.capacity });
+				}
+			} else {
+				if (mesh->indexedVertices) {
+					ranges.push_back({ AssetPool::AssetType::VertexBuffer, mesh->firstVertexIdx, mesh->vertexCount });
+					ranges.push_back({ AssetPool::AssetType::FaceBuffer, mesh->firstTriIdx, mesh->TriCount });
+				} else {
+					ranges.push_back({ AssetPool::AssetType::MeshBuffer, mesh->firstTriIdx, mesh->TriCount });
+				}
+				ranges.push_back({ AssetPool::AssetType::NodeBuffer, mesh->firstNodeIdx, mesh->nodeCount });
+				ranges.push_back({ AssetPool::AssetType::IndexBuffer, mesh->firstIndexIdx, mesh->indexCount });
+			}
+		}
+		// empty ranges would never move out of a hole's way
+		std::erase_if(ranges, [](const AssetRange& range) { return range.count == 0; });
+		return ranges;
+	}
+
+
+	bool AssetManager::ExportBVHQualityReports(const std::filesystem::path& jsonPath) const {
+		// sorted by source path so reports of the same project diff cleanly
+		std::vector<std::pair<const MeshMetadata*, const MeshMetadataExtension*>> meshes;
+		for (const auto& [guid, entry] : m_AssetPool->Metadata) {
+			auto metadata = dynamic_cast<const MeshMetadata*>(entry.first.get());
+			auto metadataExtension = dynamic_cast<const MeshMetadataExtension*>(entry.second.get());
+			if (metadata && metadataExtension) {
+				meshes.emplace_back(metadata, metadataExtension);
+			}
+		}
+		std::sort(meshes.begin(), meshes.end(), [](const auto& a, const auto& b) { return a.second->sourcePath < b.second->sourcePath; });
+
+		std::ofstream file(jsonPath, std::ios::trunc);
+		if (!file.is_open()) {
+			LOG_ENGINE_ERROR("ExportBVHQualityReports: could not open {0} for writing - permissions or path invalid", jsonPath.string());
+			return false;
+		}
+
+		file << "[";
+		for (size_t i = 0; i < meshes.size(); i++) {
+			const auto& [metadata, metadataExtension] = meshes[i];
+			const BVHQualityReport& quality = metadataExtension->bvhQuality;
+			const BVHBuildOptions& options = metadataExtension->bvhOptions;
+			std::string histogram;
+			for (uint32_t bucket = 0; bucket < BVHQualityReport::LEAF_HISTOGRAM_BUCKETS; bucket++) {
+				histogram += fmt::format("{}{}", bucket ? ", " : "", quality.leafSizeHistogram[bucket]);
+			}
+
+			file << (i ? ",\n" : "\n") << fmt::format(
+				"  {{\n"
+				"    \"source\": {}, \"triangles\": {}, \"nodes\": {}, \"triangleRefs\": {},\n"
+				"    \"builder\": {}, \"binCount\": {}, \"duplicationBudget\": {}, \"leafOrdered\": {},\n"
+				"    \"sahCost\": {}, \"sahInflation\": {}, \"maxDepth\": {}, \"avgLeafDepth\": {},\n"
+				"    \"leafCount\": {}, \"avgLeafSize\": {}, \"leafSizeHistogram\": [{}], \"siblingOverlapRatio\": {},\n"
+				"    \"fromGeometryCache\": {}, \"setupTimeMs\": {:.3f}, \"buildTimeMs\": {:.3f}, \"optimizeTimeMs\": {:.3f}, \"leafOrderTimeMs\": {:.3f}\n"
+				"  }}",
+				JsonString(metadata->staticBatch ? "<static batch>" : metadataExtension->sourcePath.generic_string()), metadata->TriCount, metadata->nodeCount, metadata->indexCount,
+				JsonString(quality.builder), options.binCount, options.spatialSplits ? options.duplicationBudget : 0.0f, metadata->leafOrdered,
+				quality.sahCost, metadataExtension->bvhBuildSAHInflation, quality.maxDepth, quality.avgLeafDepth,
+				quality.leafCount, quality.avgLeafSize, histogram, quality.siblingOverlapRatio,
+				quality.fromGeometryCache, quality.setupTimeMs, quality.buildTimeMs, quality.optimizeTimeMs, quality.leafOrderTimeMs);
+		}
+		file << (meshes.empty() ? "]\n" : "\n]\n");
+
+		if (!file) {
+			LOG_ENGINE_ERROR("ExportBVHQualityReports: failed writing {0}", jsonPath.string());
+			return false;
+		}
+		LOG_ENGINE_INFO("ExportBVHQualityReports: wrote {0} mesh reports to {1}", meshes.size(), jsonPath.string());
 		return true;
 	}
 
@@ -268,12 +1110,13 @@ namespace X3
 		const size_t totalBytes = width * height * actualChannels;
 
 		std::vector<unsigned char>& textureBuffer = m_AssetPool->TextureBuffer;
+		const uint32_t appendedIdx = textureBuffer.size();
 		textureBuffer.reserve(textureBuffer.size() + totalBytes);
 		textureBuffer.insert(textureBuffer.end(), data, data + totalBytes);
 		stbi_image_free(data);
 
 		auto metadata = std::make_shared<TextureMetadata>();
-		metadata->texStartIdx = textureBuffer.size() - totalBytes;
+		metadata->texStartIdx = m_AssetPool->CommitAppendedRange(AssetPool::AssetType::TextureBuffer, textureBuffer, appendedIdx, totalBytes);
 		metadata->width = width;
 		metadata->height = height;
 		metadata->channels = actualChannels;
@@ -286,7 +1129,6 @@ namespace X3
 		metadataExt->loadTimeMs = loadTimeMs;
 
 		m_AssetPool->Metadata[guid] = { metadata, metadataExt };
-		m_AssetPool->MarkUpdated(AssetPool::AssetType::TextureBuffer);
 		m_AssetPool->MarkUpdated(AssetPool::AssetType::Metadata);
 
 		LOG_ENGINE_INFO("LoadTexture: loaded texture {0} (GUID {1}) {2}x{3} with {4} channels in {5:.2f} ms",
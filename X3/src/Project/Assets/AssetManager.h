@@ -3,9 +3,11 @@
 #include "lrpch.h"
 #include <array>
 #include <filesystem>
+#include <future>
 #include "Core/GUID.h"
 #include "Project/Assets/AssetTypes.h"
 #include "Project/Assets/BVHAccel.h"
+#include "Project/Assets/RangeAllocator.h"
 
 constexpr const char* SUPPORTED_MESH_FILE_FORMATS[]		= { ".fbx", ".obj" ,".gltf", ".glb" };
 constexpr const char* SUPPORTED_TEXTURE_FILE_FORMATS[]	= { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".hdr" };
@@ -28,10 +30,19 @@ namespace X3
 		/// Maps GUIDs to their associated metadata and optional metadata extension.
 		std::unordered_map<LR_GUID, MetadataPair> Metadata; // (polymorphic type)
 		std::vector<Triangle> MeshBuffer;
-		std::vector<uint32_t> IndexBuffer; // indirection between BVHAccel::Node and Triangles in AssetPool::MeshBuffer
+		std::vector<glm::vec3> VertexBuffer; // shared vertices of indexed meshes (MeshMetadata::indexedVertices)
+		std::vector<Face> FaceBuffer;		 // triangles of indexed meshes
+		std::vector<uint32_t> IndexBuffer; // indirection between BVHAccel::Node and Triangles in AssetPool::MeshBuffer (or Faces)
 		std::vector<BVHAccel::Node> NodeBuffer;
 		std::vector<unsigned char> TextureBuffer;
 
+		/// The mesh's triangles in whichever layout it's stored, invalidated by appends to the viewed buffers
+		inline BVHAccel::TriangleView GetTriangles(const MeshMetadata& metadata) const {
+			return metadata.indexedVertices
+				? BVHAccel::TriangleView(VertexBuffer, metadata.firstVertexIdx, FaceBuffer, metadata.firstTriIdx)
+				: BVHAccel::TriangleView(MeshBuffer, metadata.firstTriIdx, metadata.precomputedTriangles);
+		}
+
 		template <typename T>
 		std::shared_ptr<T> find(const LR_GUID& guid) const {
 			auto it = Metadata.find(guid);
@@ -50,12 +61,87 @@ namespace X3
 			IndexBuffer,
 			NodeBuffer,
 			TextureBuffer,
+			VertexBuffer,
+			FaceBuffer,
 			COUNT
 		};
-		inline void MarkUpdated(AssetType type) { m_UpdateVersions[static_cast<size_t>(type)]++; }
+		inline void MarkUpdated(AssetType type) {
+			const size_t t = static_cast<size_t>(type);
+			m_RangeBaseVersions[t] = ++m_UpdateVersions[t];
+			m_DirtyRanges[t].clear();
+			m_MovedRanges[t].clear();
+		}
 		inline uint32_t GetUpdateVersion(AssetType type) const { return m_UpdateVersions[static_cast<size_t>(type)]; }
+
+		// Updates of a few elements, in place or appended past the old end of the buffer. Listeners which have seen
+		// GetRangeBaseVersion() only need to re-upload the ranges recorded after the version they last uploaded.
+		// The last MAX_DIRTY_RANGES are kept, so only a listener that many range updates behind falls back to a full upload.
+		struct DirtyRange {
+			uint32_t version;
+			uint32_t first; // in elements of the buffer
+			uint32_t count;
+		};
+		inline void MarkRangeUpdated(AssetType type, uint32_t first, uint32_t count) {
+			const size_t t = static_cast<size_t>(type);
+			if (m_DirtyRanges[t].size() >= MAX_DIRTY_RANGES) {
+				// drop the oldest, listeners still before it fall back to a full upload
+				m_RangeBaseVersions[t] = m_DirtyRanges[t].front().version;
+				m_DirtyRanges[t].erase(m_DirtyRanges[t].begin());
+				std::erase_if(m_MovedRanges[t], [base = m_RangeBaseVersions[t]](const RangeMove& move) { return move.version <= base; });
+			}
+			m_DirtyRanges[t].push_back({ ++m_UpdateVersions[t], first, count });
+		}
+		/// Oldest version the recorded ranges (and moves) bring a listener's copy up to date from - the last full
+		/// update or the last dropped range. A listener behind it has to start over with the whole buffer.
+		inline uint32_t GetRangeBaseVersion(AssetType type) const { return m_RangeBaseVersions[static_cast<size_t>(type)]; }
+		inline const std::vector<DirtyRange>& GetDirtyRanges(AssetType type) const { return m_DirtyRanges[static_cast<size_t>(type)]; }
+
+		// Ranges slid down by AssetManager::CompactAssetPool(), the data at 'to' is also recorded as a DirtyRange.
+		// Only listeners keying something by buffer offset (e.g. the renderer's collapsed BVHs) need these.
+		struct RangeMove {
+			uint32_t version; // same as the DirtyRange of the destination
+			uint32_t from;
+			uint32_t to;
+			uint32_t count;
+		};
+		inline void MarkRangeMoved(AssetType type, uint32_t from, uint32_t to, uint32_t count) {
+			const size_t t = static_cast<size_t>(type);
+			MarkRangeUpdated(type, to, count);
+			m_MovedRanges[t].push_back({ m_UpdateVersions[t], from, to, count });
+		}
+		inline const std::vector<RangeMove>& GetMovedRanges(AssetType type) const { return m_MovedRanges[static_cast<size_t>(type)]; }
+
+		// Free ranges of the buffers (removed assets, replaced BVHs). Buffers only grow by appended ranges and only
+		// shrink along with a full update, so a listener's copy never has to drop anything between full updates.
+
+		/// Moves the 'count' elements just appended at 'first' (the old end of 'buffer') into the lowest free range
+		/// they fit and shrinks 'buffer' back. Without one they stay where they are. Either way recorded as a range
+		/// update, so importing into a big project costs listeners time proportional to the new asset.
+		/// Returns where the elements ended up.
+		template <typename T>
+		uint32_t CommitAppendedRange(AssetType type, std::vector<T>& buffer, uint32_t first, uint32_t count) {
+			const auto target = (count != 0) ? m_FreeRanges[static_cast<size_t>(type)].Allocate(count) : std::nullopt;
+			if (!target) {
+				if (count != 0) {
+					MarkRangeUpdated(type, first, count);
+				}
+				return first;
+			}
+			std::copy(buffer.begin() + first, buffer.begin() + first + count, buffer.begin() + *target);
+			buffer.resize(first);
+			MarkRangeUpdated(type, *target, count);
+			return *target;
+		}
+		inline void FreeRange(AssetType type, uint32_t first, uint32_t count) { m_FreeRanges[static_cast<size_t>(type)].Free(first, count); }
+		inline RangeAllocator& GetFreeRanges(AssetType type) { return m_FreeRanges[static_cast<size_t>(type)]; }
+		inline const RangeAllocator& GetFreeRanges(AssetType type) const { return m_FreeRanges[static_cast<size_t>(type)]; }
 	private:
+		static constexpr size_t MAX_DIRTY_RANGES = 64;
 		std::array<uint32_t, static_cast<size_t>(AssetType::COUNT)> m_UpdateVersions = {}; // initialize with 0s
+		std::array<uint32_t, static_cast<size_t>(AssetType::COUNT)> m_RangeBaseVersions = {};
+		std::array<std::vector<DirtyRange>, static_cast<size_t>(AssetType::COUNT)> m_DirtyRanges;
+		std::array<std::vector<RangeMove>, static_cast<size_t>(AssetType::COUNT)> m_MovedRanges;
+		std::array<RangeAllocator, static_cast<size_t>(AssetType::COUNT)> m_FreeRanges; // Metadata's stays empty
 	};
 	
 	
@@ -76,6 +162,8 @@ namespace X3
 
 		LR_GUID guid = LR_GUID::INVALID;
 		std::filesystem::path sourcePath;
+		BVHBuildOptions bvhOptions; // mesh assets only
+		MeshImportOptions meshOptions; // mesh assets only
 	};
 
 	/// Serialize the 'assetMetafile' as-is at the location 'metapath'.
@@ -89,6 +177,47 @@ namespace X3
 
 
 
+	// ============================================================================
+	// GEOMETRY CACHE FILE (.lrgeo)
+	// ----------------------------------------------------------------------------
+	// Binary snapshot of a mesh's triangle (or vertex & face), node & index ranges stored next to its
+	// .lrmeta, so opening a project skips Assimp and the BVH build. Only valid for
+	// the exact source contents, BVHAccel::BUILDER_VERSION and build options.
+	// ============================================================================
+	#define GEOMETRY_CACHE_FILE_EXTENSION ".lrgeo"
+
+	struct GeometryCacheKey {
+		uint64_t sourceHash = 0;	// HashFileContents() of the source asset
+		uint64_t sourceSize = 0;
+		BVHBuildOptions bvhOptions; // only the options shaping the tree are compared
+		MeshImportOptions meshOptions;
+	};
+
+	/// 64 bit hash of the file contents, read in chunks.
+	/// Returns std::nullopt if the file can't be read.
+	std::optional<uint64_t> HashFileContents(const std::filesystem::path& filepath);
+
+	/// Writes the mesh's ranges of the AssetPool buffers and its source to slot 'triangleOrder' into 'cachepath'.
+	/// Returns true on success.
+	bool SaveGeometryCache(const std::filesystem::path& cachepath, const GeometryCacheKey& key, const AssetPool& assetPool, const MeshMetadata& metadata,
+						   const std::vector<uint32_t>& triangleOrder);
+
+	/// Appends the cached ranges to the AssetPool buffers (read straight into them) and points 'metadata' at them.
+	/// Returns false with the pool untouched if the file is missing, corrupt or was written for a different key.
+	bool LoadGeometryCache(const std::filesystem::path& cachepath, const GeometryCacheKey& key, AssetPool& assetPool, MeshMetadata& metadata,
+						   std::vector<uint32_t>& triangleOrder);
+
+
+
+
+	// One mesh placed in the world, input of AssetManager::BuildStaticBatch()
+	struct StaticBatchInstance {
+		LR_GUID meshGuid;
+		glm::mat4 transform;
+		uint32_t materialSlot; // stored with each of its triangles, resolved by the renderer
+	};
+
+
 	// ============================================================================
 	// ASSET MANAGER
 	// ----------------------------------------------------------------------------
@@ -107,8 +236,46 @@ namespace X3
 		/// - Returns the new asset LR_GUID on success
 		/// - Returns LR_GUID::INVALID if unsuccessful
 		LR_GUID ImportAsset(const std::filesystem::path& assetpath);
+
+		/// Drops the asset from the AssetPool (not its files, the .lrmeta goes with the next SaveAssetPoolToFolder()).
+		/// Its buffer ranges are freed for later loads and closed up by CompactAssetPool().
+		/// Returns false if there is no asset with that GUID.
 		bool RemoveAsset(LR_GUID guid);
 
+		/// Slides the ranges behind the lowest holes of the AssetPool buffers down into them, one range at a time
+		/// until about 'maxMovedBytes' were copied (at least one range per call), and remaps the owners' metadata.
+		/// Only the moved ranges are re-uploaded. A free tail of at least a quarter of a buffer is trimmed off.
+		/// Call once per frame. Returns the number of bytes moved.
+		size_t CompactAssetPool(size_t maxMovedBytes = DEFAULT_COMPACTION_BYTES);
+
+		/// Rebuilds the BVH of a loaded mesh with different build options (e.g. spatial splits).
+		/// The new nodes & indices go into free ranges of the AssetPool (or are appended), the old ranges are freed.
+		/// The options are kept in the MeshMetadataExtension and persisted with the .lrmeta.
+		bool RebuildMeshBVH(LR_GUID guid, const BVHBuildOptions& options);
+
+		/// Overwrites the triangles of a loaded mesh (same count, e.g. deformed vertices) and refits its BVH
+		/// instead of rebuilding it. 'triangles' are in source order (as imported), they are written to wherever leaf
+		/// ordering moved them (MeshMetadataExtension::triangleOrder), so rebuilds & background BVH swaps in between don't
+		/// matter. Plain vertices even for MeshMetadata::precomputedTriangles. Indexed meshes (MeshImportOptions::indexedVertices) aren't supported. Only the mesh's triangle & node ranges are re-uploaded to the GPU.
+		/// Returns the refit quality - BVHAccel::ComputeSAHInflation() relative to the last build (1.0 = as good as built),
+		/// once it grows past ~1.15 a RebuildMeshBVH() is due. std::nullopt if unsuccessful.
+		std::optional<float> UpdateMeshTriangles(LR_GUID guid, const std::vector<Triangle>& triangles);
+
+		/// Bakes the instances' triangles into world space and builds one BVH over all of them, stored as the
+		/// in-memory mesh 'guid' (MeshMetadata::staticBatch, never saved to .lrmeta). Rebuilding an existing batch
+		/// reuses its ranges of the AssetPool while they're large enough. Instances without a loaded mesh are skipped.
+		/// Returns false (and removes the batch) if none of them has triangles.
+		bool BuildStaticBatch(LR_GUID guid, const std::vector<StaticBatchInstance>& instances);
+
+		/// Swaps in the binned SAH BVHs whose background build finished. LoadMesh() gives meshes above
+		/// BACKGROUND_BVH_MIN_TRIS a quick LBVH first and upgrades it this way, the .lrgeo cache is only
+		/// written with the SAH tree. Call once per frame before rendering. Returns the number of swapped BVHs.
+		uint32_t ApplyFinishedBVHBuilds();
+
+		/// Writes the MeshMetadataExtension::bvhQuality of every loaded mesh into a JSON array at 'jsonPath'
+		/// (overwritten), e.g. to diff BVH quality across builder changes. Returns true on success.
+		bool ExportBVHQualityReports(const std::filesystem::path& jsonPath) const;
+
 		/// Writes current metadata (not asset files) back into .lrmeta files.
 		/// Removes orphaned .lrmeta files that no longer have corresponding assets.
 		/// Logs warnings/errors but never throws or fails.
@@ -117,19 +284,73 @@ namespace X3
 		/// Loads assets with their .lrmeta files in the folder.
 		/// Skips and warns if matching asset files are missing.
 		/// Populates the AssetPool and loads as many assets as possible.
+		/// Meshes are loaded from (or cached into) .lrgeo files in the same folder from now on.
 		void LoadAssetPoolFromFolder(const std::filesystem::path& folderpath);
 
 		inline std::shared_ptr<const AssetPool> GetAssetPool() const { return m_AssetPool; }
 
+		// meshes with at least this many triangles load with an LBVH and build their SAH BVH in the background
+		static constexpr uint32_t BACKGROUND_BVH_MIN_TRIS = 50000;
+		// per frame budget of CompactAssetPool()
+		static constexpr size_t DEFAULT_COMPACTION_BYTES = 4 << 20;
+
 	private:
+		// BVH built off-thread over a copy of the mesh, node & index ranges start at 0 (relative layout)
+		struct BackgroundBVHBuild {
+			std::vector<BVHAccel::Node> nodes;
+			std::vector<uint32_t> indices;
+			double setupTimeMs = 0.0;
+			double buildTimeMs = 0.0;
+			double optimizeTimeMs = 0.0;
+		};
+
+		// AssetPool ranges a static batch is rebuilt into, sized for 'capacity' triangles (2 * capacity - 1 nodes).
+		// Freed along with the batch's metadata
+		struct StaticBatchRanges {
+			uint32_t firstTriIdx = 0;
+			uint32_t firstNodeIdx = 0;
+			uint32_t firstIndexIdx = 0;
+			uint32_t capacity = 0;
+		};
+
+		// one range of an AssetPool buffer owned by an asset
+		struct AssetRange {
+			AssetPool::AssetType type;
+			uint32_t first;
+			uint32_t count;
+		};
+
+		struct PendingBVHBuild {
+			LR_GUID guid;
+			uint32_t bvhGeneration;			// MeshMetadataExtension::bvhGeneration the build was started for
+			GeometryCacheKey cacheKey;
+			std::filesystem::path cachepath;	// empty - not cached
+			std::future<BackgroundBVHBuild> result;
+		};
+
 		std::shared_ptr<AssetPool> m_AssetPool;
+		std::filesystem::path m_GeometryCacheFolder; // empty - meshes are neither loaded from nor written to .lrgeo caches
+		std::vector<PendingBVHBuild> m_PendingBVHBuilds;
+		std::unordered_map<LR_GUID, StaticBatchRanges> m_StaticBatchRanges;
 
 		/// Internal: Dispatches to the appropriate asset loader using the file extension.
 		/// The given GUID is used to identify the asset in the AssetPool.
-		bool LoadAssetFile(const std::filesystem::path& assetpath, LR_GUID guid);
+		bool LoadAssetFile(const std::filesystem::path& assetpath, LR_GUID guid, const BVHBuildOptions& bvhOptions = {},
+						   const MeshImportOptions& meshOptions = {});
+
+		/// Internal: Reorders the mesh's Triangles (or Faces) into the leaf order of its current index range, keeping
+		/// the extension's triangleOrder up to date, and marks them updated. Returns the new MeshMetadata::leafOrdered.
+		bool ReorderMeshToLeafOrder(const MeshMetadata& metadata, MeshMetadataExtension& metadataExtension);
+
+		/// Internal: Commits the mesh's ranges just appended to the AssetPool buffers (AssetPool::CommitAppendedRange())
+		/// and points 'metadata' at where they ended up.
+		void CommitMeshRanges(MeshMetadata& metadata);
+
+		/// Internal: The AssetPool ranges owned by the asset, static batches own their whole StaticBatchRanges.
+		std::vector<AssetRange> GetAssetRanges(LR_GUID guid, const Metadata& metadata) const;
 
 		// Loaders
-		bool LoadMesh(const std::filesystem::path& assetpath, LR_GUID guid);
+		bool LoadMesh(const std::filesystem::path& assetpath, LR_GUID guid, const BVHBuildOptions& bvhOptions, const MeshImportOptions& meshOptions);
 		bool LoadTexture(const std::filesystem::path& assetpath, LR_GUID guid, const int channels = 4);
 	};
 } 
\ No newline at end of file
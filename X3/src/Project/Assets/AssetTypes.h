@@ -3,6 +3,7 @@
 #include "lrpch.h"
 #include "Core/GUID.h"
 #include <filesystem>
+#include <array>
 
 namespace X3
 {
@@ -13,6 +14,26 @@ namespace X3
 		glm::vec4 v0 = {}, v1 = {}, v2 = {};
 	};
 
+	// Intersection friendly form of a Triangle (MeshImportOptions::precomputedTriangles), same 48 bytes:
+	// v0, the edges E1 = v1 - v0 & E2 = v2 - v0, and the unnormalized geometric normal cross(E1, E2) in their w.
+	// The ray-triangle test then neither subtracts the vertices nor takes the cross product.
+	inline Triangle ToPrecomputedTriangle(const Triangle& tri) {
+		const glm::vec3 e1 = glm::vec3(tri.v1 - tri.v0), e2 = glm::vec3(tri.v2 - tri.v0);
+		const glm::vec3 ng = glm::cross(e1, e2);
+		return { glm::vec4(glm::vec3(tri.v0), ng.x), glm::vec4(e1, ng.y), glm::vec4(e2, ng.z) };
+	}
+
+	inline Triangle FromPrecomputedTriangle(const Triangle& rec) {
+		const glm::vec3 v0 = glm::vec3(rec.v0);
+		return { glm::vec4(v0, 0.0f), glm::vec4(v0 + glm::vec3(rec.v1), 0.0f), glm::vec4(v0 + glm::vec3(rec.v2), 0.0f) };
+	}
+
+	// According to std430 - 12 bytes
+	// Triangle of an indexed mesh, mesh local indices into its range of AssetPool::VertexBuffer (tightly packed vec3s)
+	struct Face {
+		uint32_t v0 = 0, v1 = 0, v2 = 0;
+	};
+
     struct Material { // default - bright green
         glm::vec4 emission = { 0.0f, 1.0f, 0.0f, 1.0f };
         glm::vec4 color = { 0.0f, 0.0f, 0.0f, 1.0f };
@@ -23,10 +44,21 @@ namespace X3
     };
 
     struct MeshMetadata : public Metadata {
-        uint32_t firstTriIdx  = 0;
-        uint32_t TriCount     = 0;
-        uint32_t firstNodeIdx = 0;
-        uint32_t nodeCount    = 0;
+        uint32_t firstTriIdx   = 0;
+        uint32_t TriCount      = 0;
+        uint32_t firstNodeIdx  = 0;
+        uint32_t nodeCount     = 0;
+        uint32_t firstIndexIdx = 0; // BVH leaves index into their own range of the IndexBuffer
+        uint32_t indexCount    = 0; // can exceed TriCount when spatial splits duplicated triangle references
+        bool leafOrdered       = false; // triangles are stored in leaf order, the index range is the identity
+        // indexed meshes store Faces in AssetPool::FaceBuffer (firstTriIdx & TriCount refer to those) over shared vertices
+        bool indexedVertices   = false;
+        bool precomputedTriangles = false; // MeshBuffer holds ToPrecomputedTriangle() records (never indexed)
+        // in-memory world space mesh of AssetManager::BuildStaticBatch() (plain Triangles, leaf ordered),
+        // v0.w of each Triangle holds the material slot of the instance it came from
+        bool staticBatch = false;
+        uint32_t firstVertexIdx = 0;
+        uint32_t vertexCount    = 0;
         ~MeshMetadata() override = default;
     };
 
@@ -38,6 +70,64 @@ namespace X3
         ~TextureMetadata() override = default;
     };
 
+    // Builder knobs for BVHAccel::Build(), stored per mesh asset (persisted in its .lrmeta)
+    struct BVHBuildOptions {
+        // Splits the top of the tree into fork/join tasks on the engine ThreadPool.
+        // The resulting layout is identical to the serial build regardless of thread count.
+        bool parallel = true;
+        // Subtrees with fewer triangles than this are built serially by a single task
+        uint32_t parallelCutoff = 8192;
+        // Number of SAH bins per axis (8, 16 or 32) - more bins find better splits but cost build time
+        uint32_t binCount = 8;
+        // SBVH: also consider spatial splits which clip triangle references against the split plane.
+        // Builds slower (serially) but overlaps far less around long thin triangles.
+        bool spatialSplits = false;
+        // Max. number of duplicated triangle references as a fraction of the triangle count
+        float duplicationBudget = 0.3f;
+        // Spatial splits are only tried where the object split children overlap by more
+        // than this fraction of the root's surface area (alpha in the SBVH paper)
+        float spatialSplitAlpha = 1e-5f;
+        // Reorders the mesh's triangles in the MeshBuffer into BVH leaf order after the build, so leaves
+        // reference contiguous triangles and the renderer skips the IndexBuffer. Not possible (and skipped)
+        // once spatial splits duplicated references.
+        bool leafOrderedTriangles = true;
+        // Restructures small treelets of the finished tree towards minimal SAH (BVHAccel::OptimizeTreelets()).
+        // Costs several times the build time for a few percent lower SAH cost (fewer node visits) - meant for shipping builds.
+        bool treeletOptimization = false;
+    };
+
+    // Geometry layout of a mesh asset, stored per mesh asset (persisted in its .lrmeta)
+    struct MeshImportOptions {
+        // Welds vertices with identical positions and stores the triangles as Faces indexing them
+        // (~18 instead of 48 bytes per triangle for typical closed meshes), else as standalone Triangles.
+        bool indexedVertices = false;
+        // Stores standalone Triangles in their precomputed intersection form (ToPrecomputedTriangle()).
+        // Same memory, less shader ALU per triangle test. Ignored for indexed meshes.
+        bool precomputedTriangles = false;
+    };
+
+    // Tree statistics of a mesh BVH (BVHAccel::Analyze()) and how long its build took, per phase.
+    // Phase times stay 0 for BVHs read from the geometry cache.
+    struct BVHQualityReport {
+        static constexpr uint32_t LEAF_HISTOGRAM_BUCKETS = 8; // leaf sizes 1, 2-3, 4-7, ..., 128+
+
+        std::string builder;        // "SAH", "SBVH" or "LBVH", "+Treelets" if optimized
+        float sahCost = 0.0f;       // BVHAccel::ComputeSAHCost()
+        uint32_t maxDepth = 0;
+        float avgLeafDepth = 0.0f;
+        uint32_t leafCount = 0;
+        float avgLeafSize = 0.0f;
+        std::array<uint32_t, LEAF_HISTOGRAM_BUCKETS> leafSizeHistogram{};
+        // summed volume shared by sibling boxes / summed volume of their parents (0 = disjoint children)
+        float siblingOverlapRatio = 0.0f;
+
+        bool fromGeometryCache = false;
+        double setupTimeMs = 0.0;      // triangle bounds & centroids
+        double buildTimeMs = 0.0;      // tree construction
+        double optimizeTimeMs = 0.0;   // BVHBuildOptions::treeletOptimization pass
+        double leafOrderTimeMs = 0.0;  // BVHBuildOptions::leafOrderedTriangles reorder
+    };
+
     // extensions with additional metadata of assets
     // renderer is not fed these
     struct MetadataExtension {
@@ -48,7 +138,15 @@ namespace X3
     };
 
     struct MeshMetadataExtension : MetadataExtension {
-        /* additional mesh specific fields ... */
+        BVHBuildOptions bvhOptions; // options the current BVH was built with
+        MeshImportOptions meshOptions;
+        uint64_t sourceHash = 0;    // HashFileContents() of the source file, keys its .lrgeo cache
+        float bvhBuildSAHInflation = 0; // BVHAccel::ComputeSAHInflation() right after the build, baseline for refits
+        uint32_t bvhGeneration = 0; // bumped whenever the BVH changes, background builds of older generations are dropped
+        // slot (relative to MeshMetadata::firstTriIdx) of every source triangle once leaf ordering moved them, empty
+        // while they are in source order. Follows every reorder, AssetManager::UpdateMeshTriangles() maps through it
+        std::vector<uint32_t> triangleOrder;
+        BVHQualityReport bvhQuality; // of the current BVH, refits only update the tree statistics
         ~MeshMetadataExtension() override = default;
     };
 
@@ -1,166 +1,1319 @@
 #include "BVHAccel.h"
-#include <algorithm> // std::min
+#include "Core/ThreadPool.h"
+#include <algorithm> // std::min, std::clamp
+#include <bit> // std::countl_zero
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define X3_BVH_SSE
+	#include <emmintrin.h>
+#endif
 
 namespace X3
 {
 
-	BVHAccel::BVHAccel(const std::vector<Triangle>& meshBuffer, const uint32_t firstTriIdx, const uint32_t triCount) 
-	: m_TriBuff(meshBuffer), m_FirstTriIdx(firstTriIdx), m_TriCount(triCount) {
+	namespace {
+		// 4-wide helpers for the binning kernel - xyz lanes hold the three axes, w is ignored
+	#ifdef X3_BVH_SSE
+		using Lane4 = __m128;
+		inline Lane4 Load4(const glm::vec4& v) { return _mm_loadu_ps(&v.x); }
+		inline Lane4 Splat4(float f) { return _mm_set1_ps(f); }
+		inline Lane4 Min4(Lane4 a, Lane4 b) { return _mm_min_ps(a, b); }
+		inline Lane4 Max4(Lane4 a, Lane4 b) { return _mm_max_ps(a, b); }
+		inline glm::vec3 ToVec3(Lane4 v) {
+			alignas(16) float f[4];
+			_mm_store_ps(f, v);
+			return glm::vec3(f[0], f[1], f[2]);
+		}
+		// half surface area of the box spanned by min/max (same as Aabb::area())
+		inline float Area4(Lane4 boxMin, Lane4 boxMax) {
+			const Lane4 e = _mm_sub_ps(boxMax, boxMin);								// x y z w
+			const Lane4 r = _mm_shuffle_ps(e, e, _MM_SHUFFLE(3, 0, 2, 1));			// y z x w
+			alignas(16) float f[4];
+			_mm_store_ps(f, _mm_mul_ps(e, r));										// xy yz zx
+			return f[0] + f[1] + f[2];
+		}
+		// bin index per axis, clamped to [0, maxBin]
+		inline glm::ivec4 BinIdx4(Lane4 centroid, Lane4 origin, Lane4 scale, Lane4 maxBin) {
+			Lane4 f = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(centroid, origin), scale), _mm_setzero_ps()), maxBin);
+			alignas(16) int i[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_cvttps_epi32(f));
+			return glm::ivec4(i[0], i[1], i[2], i[3]);
+		}
+	#else
+		using Lane4 = glm::vec4;
+		inline Lane4 Load4(const glm::vec4& v) { return v; }
+		inline Lane4 Splat4(float f) { return glm::vec4(f); }
+		inline Lane4 Min4(Lane4 a, Lane4 b) { return glm::min(a, b); }
+		inline Lane4 Max4(Lane4 a, Lane4 b) { return glm::max(a, b); }
+		inline glm::vec3 ToVec3(Lane4 v) { return glm::vec3(v); }
+		inline float Area4(Lane4 boxMin, Lane4 boxMax) {
+			const glm::vec3 e = glm::vec3(boxMax - boxMin);
+			return e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+		inline glm::ivec4 BinIdx4(Lane4 centroid, Lane4 origin, Lane4 scale, Lane4 maxBin) {
+			return glm::ivec4(glm::min(glm::max((centroid - origin) * scale, glm::vec4(0.0f)), maxBin));
+		}
+	#endif
+
+		struct Bin4 {
+			Lane4 boxMin = Splat4(FLT_MAX);
+			Lane4 boxMax = Splat4(-FLT_MAX);
+			uint32_t triCount = 0;
+		};
+
+		// spatial bins count the references entering and leaving them instead of the centroids inside
+		struct SpatialBin {
+			BVHAccel::Aabb bounds;
+			uint32_t enterCount = 0;
+			uint32_t exitCount = 0;
+		};
+
+		// spreads the lower 10 bits of 'v' apart, leaving two zero bits between each of them (Morton codes)
+		inline uint32_t ExpandBits(uint32_t v) {
+			v = (v * 0x00010001u) & 0xFF0000FFu;
+			v = (v * 0x00000101u) & 0x0F00F00Fu;
+			v = (v * 0x00000011u) & 0xC30C30C3u;
+			v = (v * 0x00000005u) & 0x49249249u;
+			return v;
+		}
+
+		// clipping can leave empty (inverted) boxes behind, those don't add any area
+		inline float SafeArea(const BVHAccel::Aabb& aabb) {
+			return glm::any(glm::greaterThan(aabb.boxMin, aabb.boxMax)) ? 0.0f : aabb.area();
+		}
+
+		inline double Volume(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+			const glm::dvec3 extent = glm::max(glm::dvec3(boxMax) - glm::dvec3(boxMin), glm::dvec3(0.0));
+			return extent.x * extent.y * extent.z;
+		}
+
+		// writes the wall clock time of its scope to 'ms' (covers every early return of the builds)
+		struct ScopedTimerMs {
+			double& ms;
+			const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			~ScopedTimerMs() { ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); }
+		};
+
+		// Working copy of a tree for BVHAccel::OptimizeTreelets() with explicit child links, so treelets can be
+		// rewired in place. Indexed like the input nodes; the leaves (and their bounds) never change.
+		struct TreeletOptimizer {
+			static constexpr uint32_t MAX_LEAVES = BVHAccel::TREELET_LEAF_COUNT;
+			static constexpr uint32_t SUBSET_COUNT = 1u << MAX_LEAVES;
+
+			const BVHAccel::Node* nodes = nullptr;
+			std::vector<uint32_t> left, right;		// interior nodes only
+			std::vector<BVHAccel::Aabb> bounds;
+			std::vector<uint32_t> subtreeTris;		// triangles below a node, decides the parallel cutoff
+			std::atomic<uint32_t> restructuredCount{ 0 };
+
+			inline bool IsLeaf(uint32_t nodeIdx) const { return nodes[nodeIdx].triCount != 0; }
+
+			// post-order, so every treelet root sees its already optimized subtrees
+			void OptimizeSubtree(uint32_t nodeIdx) {
+				if (IsLeaf(nodeIdx)) {
+					return;
+				}
+				OptimizeSubtree(left[nodeIdx]);
+				OptimizeSubtree(right[nodeIdx]);
+				OptimizeTreelet(nodeIdx);
+			}
+
+			// Grows a treelet below 'rootIdx' by repeatedly opening its largest interior leaf, then finds the
+			// SAH optimal binary tree over those leaves by dynamic programming over all leaf subsets and
+			// rewires the treelet's interior nodes accordingly. Only nodes inside the treelet are touched.
+			void OptimizeTreelet(uint32_t rootIdx) {
+				uint32_t leaves[MAX_LEAVES] = { left[rootIdx], right[rootIdx] };
+				uint32_t interior[MAX_LEAVES - 1] = { rootIdx };
+				uint32_t leafCount = 2, interiorCount = 1;
+				while (leafCount < MAX_LEAVES) {
+					int largest = -1;
+					float largestArea = -1.0f;
+					for (uint32_t i = 0; i < leafCount; i++) {
+						if (!IsLeaf(leaves[i]) && bounds[leaves[i]].area() > largestArea) {
+							largest = static_cast<int>(i);
+							largestArea = bounds[leaves[i]].area();
+						}
+					}
+					if (largest < 0) {
+						break;
+					}
+					const uint32_t opened = leaves[largest];
+					interior[interiorCount++] = opened;
+					leaves[largest] = left[opened];
+					leaves[leafCount++] = right[opened];
+				}
+				if (leafCount < 3) {
+					return; // a single interior node has nothing to rearrange
+				}
+
+				// the treelet's leaves keep their subtrees, so only its interior areas are up for optimization
+				float currentCost = 0.0f;
+				for (uint32_t i = 0; i < interiorCount; i++) {
+					currentCost += bounds[interior[i]].area();
+				}
+
+				// proper subsets are numerically smaller than their superset, so one ascending sweep sees them first
+				const uint32_t fullSet = (1u << leafCount) - 1;
+				BVHAccel::Aabb subsetBounds[SUBSET_COUNT];
+				float subsetCost[SUBSET_COUNT];
+				uint8_t bestPartition[SUBSET_COUNT];
+				for (uint32_t subset = 1; subset <= fullSet; subset++) {
+					const uint32_t lowestBit = subset & (~subset + 1);
+					subsetBounds[subset] = subsetBounds[subset ^ lowestBit];
+					subsetBounds[subset].grow(bounds[leaves[std::countr_zero(lowestBit)]]);
+					if (subset == lowestBit) {
+						subsetCost[subset] = 0.0f;
+						continue;
+					}
+
+					// partitions containing the lowest bit cover each unordered split once
+					float bestCost = FLT_MAX;
+					for (uint32_t part = (subset - 1) & subset; part != 0; part = (part - 1) & subset) {
+						if ((part & lowestBit) != 0) {
+							const float cost = subsetCost[part] + subsetCost[subset ^ part];
+							if (cost < bestCost) {
+								bestCost = cost;
+								bestPartition[subset] = static_cast<uint8_t>(part);
+							}
+						}
+					}
+					subsetCost[subset] = subsetBounds[subset].area() + bestCost;
+				}
+
+				if (subsetCost[fullSet] >= currentCost * (1.0f - 1e-5f)) {
+					return; // not worth the churn
+				}
+
+				// the root keeps its slot (its parent still points there), the other interior nodes are reused
+				uint32_t nextInterior = 1;
+				auto emit = [&](auto& self, uint32_t subset, uint32_t nodeIdx) -> void {
+					const uint32_t part = bestPartition[subset];
+					uint32_t children[2];
+					const uint32_t childSets[2] = { part, subset ^ part };
+					for (uint32_t c = 0; c < 2; c++) {
+						if (std::has_single_bit(childSets[c])) {
+							children[c] = leaves[std::countr_zero(childSets[c])];
+						} else {
+							children[c] = interior[nextInterior++];
+							self(self, childSets[c], children[c]);
+						}
+					}
+					left[nodeIdx] = children[0];
+					right[nodeIdx] = children[1];
+					bounds[nodeIdx] = subsetBounds[subset];
+					subtreeTris[nodeIdx] = subtreeTris[children[0]] + subtreeTris[children[1]];
+				};
+				emit(emit, fullSet, rootIdx);
+				restructuredCount.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			// Splits the tree into independent subtrees below the cutoff ('tasks') and the nodes above them,
+			// the latter in post-order
+			void Partition(uint32_t nodeIdx, uint32_t parallelCutoff, std::vector<uint32_t>& tasks, std::vector<uint32_t>& topNodes) const {
+				if (IsLeaf(nodeIdx) || subtreeTris[nodeIdx] < parallelCutoff) {
+					tasks.push_back(nodeIdx);
+					return;
+				}
+				Partition(left[nodeIdx], parallelCutoff, tasks, topNodes);
+				Partition(right[nodeIdx], parallelCutoff, tasks, topNodes);
+				topNodes.push_back(nodeIdx);
+			}
+
+			// same order as SubDivide() (child pair, left subtree, right subtree), leaf ranges are re-packed in it
+			void Emit(uint32_t nodeIdx, BVHAccel::Node* outNodes, uint32_t selfIdx, uint32_t& nextFreeIdx,
+					  const uint32_t* indices, std::vector<uint32_t>& outIndices) const {
+				BVHAccel::Node& node = outNodes[selfIdx];
+				node.min = bounds[nodeIdx].boxMin;
+				node.max = bounds[nodeIdx].boxMax;
+				if (IsLeaf(nodeIdx)) {
+					node.leftChild_Or_FirstTri = static_cast<uint32_t>(outIndices.size());
+					node.triCount = nodes[nodeIdx].triCount;
+					const uint32_t* first = indices + nodes[nodeIdx].leftChild_Or_FirstTri;
+					outIndices.insert(outIndices.end(), first, first + node.triCount);
+					return;
+				}
+
+				const uint32_t leftChildIdx = nextFreeIdx;
+				nextFreeIdx += 2;
+				node.leftChild_Or_FirstTri = leftChildIdx;
+				node.triCount = 0;
+				Emit(left[nodeIdx], outNodes, leftChildIdx, nextFreeIdx, indices, outIndices);
+				Emit(right[nodeIdx], outNodes, leftChildIdx + 1, nextFreeIdx, indices, outIndices);
+			}
+		};
+	}
+
+	BVHAccel::BVHAccel(const TriangleView& triangles, const uint32_t triCount)
+	: m_Triangles(triangles), m_HasTriangles(true), m_TriCount(triCount) {
+		ScopedTimerMs timer{ m_SetupTimeMs };
 		m_Centroids = PrecomputeCentroids();
+		PrecomputeTriBounds();
+	}
+
+	// triangle-less builds view this
+	static const std::vector<Triangle> s_NoTriangles;
+
+	BVHAccel::BVHAccel(const std::vector<Aabb>& primitiveBounds)
+	: m_Triangles(s_NoTriangles, 0), m_HasTriangles(false), m_TriCount(primitiveBounds.size()) {
+		ScopedTimerMs timer{ m_SetupTimeMs };
+		m_TriMin.resize(m_TriCount);
+		m_TriMax.resize(m_TriCount);
+		m_Centroids.resize(m_TriCount);
+		for (uint32_t i = 0; i < m_TriCount; i++) {
+			m_TriMin[i] = glm::vec4(primitiveBounds[i].boxMin, 0.0f);
+			m_TriMax[i] = glm::vec4(primitiveBounds[i].boxMax, 0.0f);
+			m_Centroids[i] = (m_TriMin[i] + m_TriMax[i]) * 0.5f;
+		}
+	}
+	void BVHAccel::Build(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer,
+						 uint32_t& firstNodeIdx, uint32_t& nodeCount, uint32_t& firstIndexIdx, uint32_t& indexCount,
+						 const BVHBuildOptions& options) {
+		{
+			ScopedTimerMs timer{ m_BuildTimeMs };
+			BuildTopDown(nodeBuffer, indexBuffer, firstNodeIdx, nodeCount, firstIndexIdx, indexCount, options);
+		}
+
+		m_OptimizeTimeMs = 0.0;
+		if (options.treeletOptimization) {
+			ScopedTimerMs timer{ m_OptimizeTimeMs };
+			OptimizeTreelets(nodeBuffer, firstNodeIdx, nodeCount, indexBuffer, firstIndexIdx, indexCount,
+							 options.parallel, options.parallelCutoff);
+		}
 	}
 
-	void BVHAccel::Build(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer, uint32_t& firstNodeIdx, uint32_t& nodeCount) {
+	void BVHAccel::BuildTopDown(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer,
+								uint32_t& firstNodeIdx, uint32_t& nodeCount, uint32_t& firstIndexIdx, uint32_t& indexCount,
+								const BVHBuildOptions& options) {
 		const size_t N = m_TriCount; // for convenience
 
-		size_t oldSize = nodeBuffer.size();
+		firstNodeIdx = nodeBuffer.size();
+		nodeCount = 0;
+		firstIndexIdx = indexBuffer.size();
+		indexCount = 0;
+		if (N == 0) {
+			return;
+		}
 
-		firstNodeIdx = oldSize;
-		// firstIndexBuffIdx == m_FirstTriIdx;
-		
-		// make space for new data
-		nodeBuffer.resize(nodeBuffer.size() + 2 * N - 1);
-		indexBuffer.resize(indexBuffer.size() + N);
+		m_Options = options;
+		if (m_Options.binCount != 8 && m_Options.binCount != 16 && m_Options.binCount != 32) {
+			m_Options.binCount = 8;
+		}
+		if (!m_HasTriangles) {
+			m_Options.spatialSplits = false; // bounding box primitives can't be clipped
+		}
 
-		m_NodeBuff = &nodeBuffer[firstNodeIdx];
-		m_IdxBuff = &indexBuffer[m_FirstTriIdx];
-		for (int i = 0; i < N; i++) {
-			m_IdxBuff[i] = i;
+		if (m_Options.spatialSplits) {
+			// every reference (including the duplicates) needs a slot up front so m_IdxBuff stays valid
+			m_DuplicatesLeft = static_cast<uint32_t>(N * std::clamp(m_Options.duplicationBudget, 0.0f, 4.0f));
+			const size_t capacity = N + m_DuplicatesLeft;
+			m_RefTris.resize(capacity);
+			m_Centroids.resize(capacity);
+			m_TriMin.resize(capacity);
+			m_TriMax.resize(capacity);
+			m_IdxBuff = m_RefTris.data();
+			for (uint32_t i = 0; i < N; i++) {
+				m_IdxBuff[i] = i;
+				m_Centroids[i] = (m_TriMin[i] + m_TriMax[i]) * 0.5f; // references are binned by their bounds
+			}
+			m_RefTop = N;
+		} else {
+			// make space for new data
+			indexBuffer.resize(indexBuffer.size() + N);
+			m_IdxBuff = &indexBuffer[firstIndexIdx];
+			for (size_t i = 0; i < N; i++) {
+				m_IdxBuff[i] = static_cast<uint32_t>(i);
+			}
+			indexCount = N;
 		}
 
-		m_NodesUsed = 0;
-		Node& root = m_NodeBuff[m_NodesUsed++];
+		Node root{};
 		root.leftChild_Or_FirstTri = 0;
 		root.triCount = N;
+		Aabb rootCentroids;
+		UpdateAABB(root, rootCentroids);
+
+		if (m_Options.spatialSplits) {
+			m_RootArea = Aabb(root.min, root.max).area();
+
+			std::vector<Node> nodes;
+			nodes.reserve(2 * (N + m_DuplicatesLeft) - 1);
+			nodes.push_back(root);
+			std::vector<uint32_t> leafIndices;
+			leafIndices.reserve(N + m_DuplicatesLeft);
+			SubDivideSpatial(nodes, 0, rootCentroids, leafIndices);
+
+			nodeCount = nodes.size();
+			nodeBuffer.insert(nodeBuffer.end(), nodes.begin(), nodes.end());
+			indexCount = leafIndices.size();
+			indexBuffer.insert(indexBuffer.end(), leafIndices.begin(), leafIndices.end());
+			m_IdxBuff = nullptr;
+			return;
+		}
+
+		if (!options.parallel || N < options.parallelCutoff) {
+			std::vector<Node> nodes;
+			nodes.reserve(2 * N - 1);
+			nodes.push_back(root);
+			SubDivide(nodes, 0, rootCentroids);
+
+			nodeCount = nodes.size();
+			nodeBuffer.insert(nodeBuffer.end(), nodes.begin(), nodes.end());
+			return;
+		}
+
+		BuildTask rootTask;
+		rootTask.node = root;
+		rootTask.centroidBounds = rootCentroids;
+		SubDivideParallel(rootTask);
+
+		// tasks finished in arbitrary order, the emitted layout only depends on the tree itself
+		nodeCount = 1 + CountDescendants(rootTask);
+		nodeBuffer.resize(firstNodeIdx + nodeCount);
+		uint32_t nextFreeIdx = 1;
+		EmitTask(rootTask, &nodeBuffer[firstNodeIdx], 0, nextFreeIdx);
+	}
+
+	void BVHAccel::BuildLinear(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer,
+							   uint32_t& firstNodeIdx, uint32_t& nodeCount, uint32_t& firstIndexIdx, uint32_t& indexCount) {
+		ScopedTimerMs timer{ m_BuildTimeMs };
+		const uint32_t N = m_TriCount;
+
+		firstNodeIdx = nodeBuffer.size();
+		nodeCount = 0;
+		firstIndexIdx = indexBuffer.size();
+		indexCount = 0;
+		if (N == 0) {
+			return;
+		}
+
+		// Morton code in the upper, triangle index in the lower 32 bits
+		Aabb centroidBounds;
+		for (uint32_t i = 0; i < N; i++) {
+			centroidBounds.grow(glm::vec3(m_Centroids[i]));
+		}
+		const glm::vec3 scale = 1023.0f / glm::max(centroidBounds.boxMax - centroidBounds.boxMin, glm::vec3(1e-20f));
+		std::vector<uint64_t> keys(N);
+		for (uint32_t i = 0; i < N; i++) {
+			const glm::uvec3 q = glm::uvec3(glm::clamp((glm::vec3(m_Centroids[i]) - centroidBounds.boxMin) * scale, 0.0f, 1023.0f));
+			const uint32_t code = (ExpandBits(q.x) << 2) | (ExpandBits(q.y) << 1) | ExpandBits(q.z);
+			keys[i] = (uint64_t(code) << 32) | i;
+		}
+
+		// LSD radix sort of the 30 code bits in 3 passes of 10 bits
+		std::vector<uint64_t> sortedKeys(N);
+		for (uint32_t shift = 32; shift < 62; shift += 10) {
+			std::array<uint32_t, 1024> offsets{};
+			for (uint64_t key : keys) {
+				offsets[(key >> shift) & 1023]++;
+			}
+			uint32_t sum = 0;
+			for (uint32_t& offset : offsets) {
+				const uint32_t count = offset;
+				offset = sum;
+				sum += count;
+			}
+			for (uint64_t key : keys) {
+				sortedKeys[offsets[(key >> shift) & 1023]++] = key;
+			}
+			keys.swap(sortedKeys);
+		}
+
+		// the sorted order is the leaf order, the leaf bounds read a copy of the triangle bounds in it so m_TriMin
+		// & m_TriMax keep their triangle order
+		indexBuffer.resize(firstIndexIdx + N);
+		m_IdxBuff = &indexBuffer[firstIndexIdx];
+		std::vector<uint32_t> codes(N);
+		std::vector<glm::vec4> triMin(N), triMax(N);
+		for (uint32_t i = 0; i < N; i++) {
+			const uint32_t triIdx = static_cast<uint32_t>(keys[i]);
+			m_IdxBuff[i] = triIdx;
+			codes[i] = static_cast<uint32_t>(keys[i] >> 32);
+			triMin[i] = m_TriMin[triIdx];
+			triMax[i] = m_TriMax[triIdx];
+		}
+		indexCount = N;
+
+		std::vector<Node> nodes;
+		nodes.reserve(2 * N - 1);
+		Node root{};
+		root.leftChild_Or_FirstTri = 0;
+		root.triCount = N;
+		nodes.push_back(root);
+		SubDivideLinear(nodes, 0, codes);
+
+		// bounds bottom-up, children are stored after their parent
+		for (uint32_t nodeIdx = nodes.size(); nodeIdx-- > 0;) {
+			Node& node = nodes[nodeIdx];
+			if (node.triCount != 0) {
+				Lane4 boxMin = Splat4(FLT_MAX), boxMax = Splat4(-FLT_MAX);
+				for (uint32_t i = 0; i < node.triCount; i++) {
+					boxMin = Min4(boxMin, Load4(triMin[node.leftChild_Or_FirstTri + i]));
+					boxMax = Max4(boxMax, Load4(triMax[node.leftChild_Or_FirstTri + i]));
+				}
+				node.min = ToVec3(boxMin);
+				node.max = ToVec3(boxMax);
+			} else {
+				const Node& left = nodes[node.leftChild_Or_FirstTri];
+				const Node& right = nodes[node.leftChild_Or_FirstTri + 1];
+				node.min = glm::min(left.min, right.min);
+				node.max = glm::max(left.max, right.max);
+			}
+		}
+
+		nodeCount = nodes.size();
+		nodeBuffer.insert(nodeBuffer.end(), nodes.begin(), nodes.end());
+		m_IdxBuff = nullptr;
+	}
+
+	void BVHAccel::SubDivideLinear(std::vector<Node>& nodes, uint32_t nodeIdx, const std::vector<uint32_t>& codes) const {
+		const uint32_t first = nodes[nodeIdx].leftChild_Or_FirstTri;
+		const uint32_t count = nodes[nodeIdx].triCount;
+		if (count <= LBVH_MAX_LEAF_SIZE) {
+			return;
+		}
+
+		// the codes are sorted, so the range splits where its highest differing bit flips (equal codes are halved)
+		const uint32_t last = first + count - 1;
+		uint32_t split = first + count / 2;
+		if (const uint32_t differingBits = codes[first] ^ codes[last]; differingBits != 0) {
+			const uint32_t highestBit = 1u << (31 - std::countl_zero(differingBits));
+			split = static_cast<uint32_t>(std::partition_point(codes.begin() + first, codes.begin() + last + 1,
+				[highestBit](uint32_t code) { return (code & highestBit) == 0; }) - codes.begin());
+		}
+
+		Node leftChild{}, rightChild{};
+		leftChild.leftChild_Or_FirstTri = first;
+		leftChild.triCount = split - first;
+		rightChild.leftChild_Or_FirstTri = split;
+		rightChild.triCount = first + count - split;
+
+		// find indices for the new child nodes (push_back may reallocate - only hold indices)
+		uint32_t leftChildIdx = nodes.size();
+		nodes.push_back(leftChild);
+		nodes.push_back(rightChild);
+
+		nodes[nodeIdx].triCount = 0; // ! mark the node as non-leaf node
+		nodes[nodeIdx].leftChild_Or_FirstTri = leftChildIdx; // now points to the leftChild node
+
+		SubDivideLinear(nodes, leftChildIdx, codes);
+		SubDivideLinear(nodes, leftChildIdx + 1, codes);
+	}
+
+	float BVHAccel::Refit(std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount,
+						  const std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, const TriangleView& triangles) {
+		Node* nodes = nodeBuffer.data() + firstNodeIdx;
+		// reverse order visits both children before their parent
+		for (uint32_t nodeIdx = nodeCount; nodeIdx-- > 0;) {
+			Node& node = nodes[nodeIdx];
+			if (node.triCount != 0) {
+				Lane4 boxMin = Splat4(FLT_MAX), boxMax = Splat4(-FLT_MAX);
+				for (uint32_t i = 0; i < node.triCount; i++) {
+					glm::vec3 v0, v1, v2;
+					triangles.Fetch(indexBuffer[firstIndexIdx + node.leftChild_Or_FirstTri + i], v0, v1, v2);
+					const Lane4 p0 = Load4(glm::vec4(v0, 0.0f)), p1 = Load4(glm::vec4(v1, 0.0f)), p2 = Load4(glm::vec4(v2, 0.0f));
+					boxMin = Min4(Min4(boxMin, p0), Min4(p1, p2));
+					boxMax = Max4(Max4(boxMax, p0), Max4(p1, p2));
+				}
+				node.min = ToVec3(boxMin);
+				node.max = ToVec3(boxMax);
+			} else {
+				const Node& left = nodes[node.leftChild_Or_FirstTri];
+				const Node& right = nodes[node.leftChild_Or_FirstTri + 1];
+				node.min = glm::min(left.min, right.min);
+				node.max = glm::max(left.max, right.max);
+			}
+		}
+		return ComputeSAHInflation(nodeBuffer, firstNodeIdx, nodeCount, indexBuffer, firstIndexIdx, triangles);
+	}
+
+	float BVHAccel::ComputeSAHCost(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount) {
+		if (nodeCount == 0) {
+			return 0.0f;
+		}
+		double cost = 0.0;
+		for (uint32_t nodeIdx = firstNodeIdx; nodeIdx < firstNodeIdx + nodeCount; nodeIdx++) {
+			const Node& node = nodeBuffer[nodeIdx];
+			cost += double(Aabb(node.min, node.max).area()) * ((node.triCount != 0) ? node.triCount : 1);
+		}
+		const float rootArea = Aabb(nodeBuffer[firstNodeIdx].min, nodeBuffer[firstNodeIdx].max).area();
+		return (rootArea > 0.0f) ? float(cost / rootArea) : 0.0f;
+	}
+
+	float BVHAccel::ComputeSAHInflation(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount,
+										const std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, const TriangleView& triangles) {
+		double cost = 0.0, triArea = 0.0;
+		for (uint32_t nodeIdx = firstNodeIdx; nodeIdx < firstNodeIdx + nodeCount; nodeIdx++) {
+			const Node& node = nodeBuffer[nodeIdx];
+			cost += double(Aabb(node.min, node.max).area()) * ((node.triCount != 0) ? node.triCount : 1);
+			for (uint32_t i = 0; i < node.triCount; i++) {
+				glm::vec3 v0, v1, v2;
+				triangles.Fetch(indexBuffer[firstIndexIdx + node.leftChild_Or_FirstTri + i], v0, v1, v2);
+				Aabb triBounds(v0, v0);
+				triBounds.grow(v1);
+				triBounds.grow(v2);
+				triArea += triBounds.area();
+			}
+		}
+		return (triArea > 0.0) ? float(cost / triArea) : 0.0f;
+	}
+
+	void BVHAccel::OptimizeTreelets(std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount,
+									std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, uint32_t indexCount,
+									bool parallel, uint32_t parallelCutoff) {
+		if (nodeCount < 5) {
+			return; // no treelet with more than two leaves
+		}
+
+		TreeletOptimizer optimizer;
+		optimizer.nodes = nodeBuffer.data() + firstNodeIdx;
+		optimizer.left.assign(nodeCount, 0);
+		optimizer.right.assign(nodeCount, 0);
+		optimizer.bounds.resize(nodeCount);
+		optimizer.subtreeTris.assign(nodeCount, 0);
+		// reverse order visits both children before their parent
+		for (uint32_t nodeIdx = nodeCount; nodeIdx-- > 0;) {
+			const Node& node = optimizer.nodes[nodeIdx];
+			optimizer.bounds[nodeIdx] = Aabb(node.min, node.max);
+			if (node.triCount != 0) {
+				optimizer.subtreeTris[nodeIdx] = node.triCount;
+			} else {
+				optimizer.left[nodeIdx] = node.leftChild_Or_FirstTri;
+				optimizer.right[nodeIdx] = node.leftChild_Or_FirstTri + 1;
+				optimizer.subtreeTris[nodeIdx] = optimizer.subtreeTris[node.leftChild_Or_FirstTri] + optimizer.subtreeTris[node.leftChild_Or_FirstTri + 1];
+			}
+		}
+
+		for (uint32_t pass = 0; pass < TREELET_PASSES; pass++) {
+			optimizer.restructuredCount = 0;
+			if (parallel && optimizer.subtreeTris[0] >= parallelCutoff) {
+				// treelets never reach above their root, so disjoint subtrees are optimized concurrently and the
+				// nodes above them afterwards - the same result as the serial post-order walk
+				std::vector<uint32_t> tasks, topNodes;
+				optimizer.Partition(0, parallelCutoff, tasks, topNodes);
+				ThreadPool& pool = ThreadPool::Get();
+				ThreadPool::JobCounter counter;
+				for (uint32_t taskRoot : tasks) {
+					pool.Submit([&optimizer, taskRoot]() { optimizer.OptimizeSubtree(taskRoot); }, counter);
+				}
+				pool.Wait(counter);
+				for (uint32_t nodeIdx : topNodes) {
+					optimizer.OptimizeTreelet(nodeIdx);
+				}
+			} else {
+				optimizer.OptimizeSubtree(0);
+			}
+
+			if (optimizer.restructuredCount == 0) {
+				break;
+			}
+		}
+
+		// rewiring scattered the child pairs, emit depth-first again (children after their parent, pairs adjacent)
+		std::vector<Node> nodes(nodeCount);
+		std::vector<uint32_t> indices;
+		indices.reserve(indexCount);
+		uint32_t nextFreeIdx = 1;
+		optimizer.Emit(0, nodes.data(), 0, nextFreeIdx, indexBuffer.data() + firstIndexIdx, indices);
+		std::copy(nodes.begin(), nodes.end(), nodeBuffer.begin() + firstNodeIdx);
+		std::copy(indices.begin(), indices.end(), indexBuffer.begin() + firstIndexIdx);
+	}
+
+	void BVHAccel::Analyze(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount, BVHQualityReport& report) {
+		report.sahCost = 0.0f;
+		report.maxDepth = 0;
+		report.avgLeafDepth = 0.0f;
+		report.leafCount = 0;
+		report.avgLeafSize = 0.0f;
+		report.leafSizeHistogram.fill(0);
+		report.siblingOverlapRatio = 0.0f;
+		if (nodeCount == 0) {
+			return;
+		}
+		report.sahCost = ComputeSAHCost(nodeBuffer, firstNodeIdx, nodeCount);
+
+		// children are stored after their parent, one forward pass hands the depths down
+		const Node* nodes = nodeBuffer.data() + firstNodeIdx;
+		std::vector<uint32_t> depths(nodeCount, 0);
+		uint64_t leafDepthSum = 0, leafTriSum = 0;
+		double overlapVolume = 0.0, parentVolume = 0.0;
+		for (uint32_t nodeIdx = 0; nodeIdx < nodeCount; nodeIdx++) {
+			const Node& node = nodes[nodeIdx];
+			const uint32_t depth = depths[nodeIdx];
+			report.maxDepth = std::max(report.maxDepth, depth);
+			if (node.triCount != 0) {
+				report.leafCount++;
+				leafDepthSum += depth;
+				leafTriSum += node.triCount;
+				const uint32_t bucket = std::min<uint32_t>(31 - std::countl_zero(node.triCount), BVHQualityReport::LEAF_HISTOGRAM_BUCKETS - 1);
+				report.leafSizeHistogram[bucket]++;
+				continue;
+			}
+
+			const Node& left = nodes[node.leftChild_Or_FirstTri];
+			const Node& right = nodes[node.leftChild_Or_FirstTri + 1];
+			depths[node.leftChild_Or_FirstTri] = depths[node.leftChild_Or_FirstTri + 1] = depth + 1;
+			overlapVolume += Volume(glm::max(left.min, right.min), glm::min(left.max, right.max));
+			parentVolume += Volume(node.min, node.max);
+		}
+		report.avgLeafDepth = float(double(leafDepthSum) / report.leafCount);
+		report.avgLeafSize = float(double(leafTriSum) / report.leafCount);
+		report.siblingOverlapRatio = (parentVolume > 0.0) ? float(overlapVolume / parentVolume) : 0.0f;
+	}
+
+	void BVHAccel::Collapse(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount, uint32_t width,
+							std::vector<WidePacket>& wideBuffer, uint32_t& firstPacketIdx, uint32_t& packetCount) {
+		constexpr uint32_t MAX_WIDTH = 8;
+		firstPacketIdx = static_cast<uint32_t>(wideBuffer.size());
+		packetCount = 0;
+		if (nodeCount == 0 || (width != 4 && width != MAX_WIDTH)) {
+			return;
+		}
+
+		const Node* nodes = nodeBuffer.data() + firstNodeIdx;
+		const uint32_t packetsPerNode = width / 4;
+		auto AllocateNode = [&]() {
+			const uint32_t packetIdx = static_cast<uint32_t>(wideBuffer.size()) - firstPacketIdx;
+			wideBuffer.resize(wideBuffer.size() + packetsPerNode);
+			return packetIdx;
+		};
+
+		// (binary node, wide node) pairs still to be filled
+		std::vector<std::pair<uint32_t, uint32_t>> stack;
+		stack.emplace_back(0, AllocateNode());
+		while (!stack.empty()) {
+			auto [binaryIdx, packetIdx] = stack.back();
+			stack.pop_back();
 
-		UpdateAABB(root);
-		SubDivide(root);
+			// the binary node's children, opening the largest inner one until the node is full
+			// (only a leaf root has nothing to open and becomes the single child of the wide root)
+			uint32_t children[MAX_WIDTH];
+			uint32_t childCount = 0;
+			if (nodes[binaryIdx].triCount != 0) {
+				children[childCount++] = binaryIdx;
+			} else {
+				children[childCount++] = nodes[binaryIdx].leftChild_Or_FirstTri;
+				children[childCount++] = nodes[binaryIdx].leftChild_Or_FirstTri + 1;
+			}
+			while (childCount < width) {
+				int largest = -1;
+				float largestArea = -1.0f;
+				for (uint32_t i = 0; i < childCount; i++) {
+					const Node& child = nodes[children[i]];
+					const float area = Aabb(child.min, child.max).area();
+					if (child.triCount == 0 && area > largestArea) {
+						largest = static_cast<int>(i);
+						largestArea = area;
+					}
+				}
+				if (largest < 0) {
+					break; // all leaves
+				}
+				const uint32_t opened = children[largest];
+				children[largest] = nodes[opened].leftChild_Or_FirstTri;
+				children[childCount++] = nodes[opened].leftChild_Or_FirstTri + 1;
+			}
+
+			for (uint32_t slot = 0; slot < width; slot++) {
+				// no references into wideBuffer, AllocateNode() may reallocate it
+				const uint32_t packet = firstPacketIdx + packetIdx + slot / 4;
+				const uint32_t lane = slot % 4;
+				if (slot >= childCount) {
+					wideBuffer[packet].minX[lane] = wideBuffer[packet].minY[lane] = wideBuffer[packet].minZ[lane] = FLT_MAX;
+					wideBuffer[packet].maxX[lane] = wideBuffer[packet].maxY[lane] = wideBuffer[packet].maxZ[lane] = -FLT_MAX;
+					wideBuffer[packet].child[lane] = WIDE_EMPTY_SLOT;
+					wideBuffer[packet].triCount[lane] = 0;
+					continue;
+				}
+
+				const Node& child = nodes[children[slot]];
+				uint32_t childIdx = child.leftChild_Or_FirstTri;
+				if (child.triCount == 0) {
+					childIdx = AllocateNode();
+					stack.emplace_back(children[slot], childIdx);
+				}
+				wideBuffer[packet].minX[lane] = child.min.x;
+				wideBuffer[packet].minY[lane] = child.min.y;
+				wideBuffer[packet].minZ[lane] = child.min.z;
+				wideBuffer[packet].maxX[lane] = child.max.x;
+				wideBuffer[packet].maxY[lane] = child.max.y;
+				wideBuffer[packet].maxZ[lane] = child.max.z;
+				wideBuffer[packet].child[lane] = childIdx;
+				wideBuffer[packet].triCount[lane] = child.triCount;
+			}
+		}
+		packetCount = static_cast<uint32_t>(wideBuffer.size()) - firstPacketIdx;
+	}
+
+	BVHAccel::QuantizedPacket BVHAccel::Quantize(const WidePacket& packet) {
+		constexpr uint32_t Q_MAX = 255;
+		QuantizedPacket quantized{};
+		quantized.child = packet.child;
+		quantized.triCount = packet.triCount;
+
+		const glm::vec4* mins[3] = { &packet.minX, &packet.minY, &packet.minZ };
+		const glm::vec4* maxs[3] = { &packet.maxX, &packet.maxY, &packet.maxZ };
+		uint32_t* qMins[3] = { &quantized.qMinX, &quantized.qMinY, &quantized.qMinZ_MaxXYZ.x };
+		uint32_t* qMaxs[3] = { &quantized.qMinZ_MaxXYZ.y, &quantized.qMinZ_MaxXYZ.z, &quantized.qMinZ_MaxXYZ.w };
+
+		for (int axis = 0; axis < 3; axis++) {
+			float boxMin = FLT_MAX, boxMax = -FLT_MAX;
+			for (int lane = 0; lane < 4; lane++) {
+				if (packet.child[lane] != WIDE_EMPTY_SLOT) {
+					boxMin = std::min(boxMin, (*mins[axis])[lane]);
+					boxMax = std::max(boxMax, (*maxs[axis])[lane]);
+				}
+			}
+			if (boxMin > boxMax) {
+				boxMin = boxMax = 0.0f; // no children
+			}
 
-		nodeCount = m_NodesUsed;
-		nodeBuffer.resize(oldSize + m_NodesUsed); // Erase the unused space ( if we used less than 2N-1 nodes)
+			// smallest power of two step covering the box with a grid cell to spare for snapping the origin,
+			// but no finer than 2^-15 of the magnitude so every origin + q * scale is a representable float
+			const float extent = boxMax - boxMin;
+			int exponent = (extent > 0.0f) ? static_cast<int>(std::ceil(std::log2(extent / (Q_MAX - 1)))) : -126;
+			const float maxAbs = std::max(std::abs(boxMin), std::abs(boxMax));
+			if (maxAbs > 0.0f) {
+				exponent = std::max(exponent, std::ilogb(maxAbs) - 15);
+			}
+			exponent = std::clamp(exponent, -126, 127);
+			const double scale = std::ldexp(1.0, exponent);
+			const double origin = std::floor(boxMin / scale) * scale;
+			quantized.origin[axis] = static_cast<float>(origin);
+			quantized.scale[axis] = static_cast<float>(scale);
+
+			// round outwards, empty slots decode to an (ignored) zero sized box
+			*qMins[axis] = *qMaxs[axis] = 0;
+			for (int lane = 0; lane < 4; lane++) {
+				if (packet.child[lane] == WIDE_EMPTY_SLOT) {
+					continue;
+				}
+				const double qMin = std::floor(((*mins[axis])[lane] - origin) / scale);
+				const double qMax = std::ceil(((*maxs[axis])[lane] - origin) / scale);
+				*qMins[axis] |= static_cast<uint32_t>(std::clamp(qMin, 0.0, double(Q_MAX))) << (8 * lane);
+				*qMaxs[axis] |= static_cast<uint32_t>(std::clamp(qMax, 0.0, double(Q_MAX))) << (8 * lane);
+			}
+		}
+		return quantized;
 	}
 
-	void BVHAccel::UpdateAABB(Node& node) {
-		Aabb aabb;
+	void BVHAccel::UpdateAABB(Node& node, Aabb& centroidBounds) const {
+		Lane4 boxMin = Splat4(FLT_MAX), boxMax = Splat4(-FLT_MAX);
+		Lane4 centroidMin = Splat4(FLT_MAX), centroidMax = Splat4(-FLT_MAX);
 		// iterate over primitives contained by the Node
-		for (size_t i = 0; i < node.triCount; i++) { // every 3rd vertex is new triangle
-			const Triangle& t = m_TriBuff[m_FirstTriIdx + m_IdxBuff[node.leftChild_Or_FirstTri + i]];
-			aabb.grow(glm::vec3(t.v0));
-			aabb.grow(glm::vec3(t.v1));
-			aabb.grow(glm::vec3(t.v2));
+		for (size_t i = 0; i < node.triCount; i++) {
+			const uint32_t refIdx = node.leftChild_Or_FirstTri + i;
+			boxMin = Min4(boxMin, Load4(m_TriMin[refIdx]));
+			boxMax = Max4(boxMax, Load4(m_TriMax[refIdx]));
+			const Lane4 centroid = Load4(m_Centroids[refIdx]);
+			centroidMin = Min4(centroidMin, centroid);
+			centroidMax = Max4(centroidMax, centroid);
 		}
-		node.min = aabb.boxMin;
-		node.max = aabb.boxMax;
+		node.min = ToVec3(boxMin);
+		node.max = ToVec3(boxMax);
+		centroidBounds = Aabb(ToVec3(centroidMin), ToVec3(centroidMax));
 	}
 
-	// SAH Heuristic in O(n) time
-	float BVHAccel::FindBestSplitPlane(Node& node, int& splitAxis, float& splitPos) {
-		const size_t BINS = 8;
-		float bestPos = 0, bestCost = FLT_MAX;
+	template <uint32_t BINS>
+	bool BVHAccel::FindBestSplitPlane(const Node& node, const Aabb& centroidBounds, SplitPlane& split) const {
+		// map centroids to bins on every axis at once, flat axes get a zero scale (everything lands in bin 0)
+		const glm::vec3 extent = centroidBounds.boxMax - centroidBounds.boxMin;
+		glm::vec4 scale(0.0f);
 		for (int axis = 0; axis < 3; axis++) {
-			// finding the bounds of the triangle centroids
-			float aabbMin = FLT_MAX;
-			float aabbMax = -FLT_MAX;
-			for (int i = 0; i < node.triCount; i++) {
-				glm::vec3& centroid = m_Centroids[m_IdxBuff[node.leftChild_Or_FirstTri + i]];
-				aabbMin = glm::min(aabbMin, centroid[axis]);
-				aabbMax = glm::max(aabbMax, centroid[axis]);
+			if (extent[axis] > 0.0f) {
+				scale[axis] = BINS / extent[axis];
 			}
+		}
+		if (scale.x == 0.0f && scale.y == 0.0f && scale.z == 0.0f) {
+			return false; // all centroids coincide, nothing to bin
+		}
+		const glm::vec4 origin(centroidBounds.boxMin, 0.0f);
+		const Lane4 origin4 = Load4(origin), scale4 = Load4(scale), maxBin4 = Splat4(float(BINS - 1));
 
-			if (aabbMin == aabbMax) { 
-				continue; 
+		// single pass over the node's triangles filling the bins of all three axes
+		Bin4 bins[3][BINS];
+		for (uint32_t i = 0; i < node.triCount; i++) {
+			const uint32_t refIdx = node.leftChild_Or_FirstTri + i;
+			const glm::ivec4 binIdx = BinIdx4(Load4(m_Centroids[refIdx]), origin4, scale4, maxBin4);
+			const Lane4 triMin = Load4(m_TriMin[refIdx]);
+			const Lane4 triMax = Load4(m_TriMax[refIdx]);
+			for (int axis = 0; axis < 3; axis++) {
+				Bin4& bin = bins[axis][binIdx[axis]];
+				bin.boxMin = Min4(bin.boxMin, triMin);
+				bin.boxMax = Max4(bin.boxMax, triMax);
+				bin.triCount++;
 			}
+		}
 
-			// splitting the bounds into bins (allows merging intervals quickly)
-			Bin bin[BINS];
-			float scale = BINS / (aabbMax - aabbMin);
-			for (uint32_t i = 0; i < node.triCount; i++) {
-				size_t triIdx = m_IdxBuff[node.leftChild_Or_FirstTri + i];
-				const Triangle& tri = m_TriBuff[m_FirstTriIdx + triIdx];
-				size_t binIdx = std::min(BINS - 1, (size_t)((m_Centroids[triIdx][axis] - aabbMin) * scale));
-				bin[binIdx].triCount++;
-				bin[binIdx].aabb.grow(tri.v0);
-				bin[binIdx].aabb.grow(tri.v1);
-				bin[binIdx].aabb.grow(tri.v2);
+		split.cost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++) {
+			if (scale[axis] == 0.0f) {
+				continue;
 			}
 
-			float leftArea[BINS - 1], rightArea[BINS - 1];
-			int leftCount[BINS - 1], rightCount[BINS - 1];
 			// both directions simultaneously 
-			size_t currLeftCount = 0, currRightCount = 0;
-			Aabb currLeftAabb, currRightAabb;
-			for (uint32_t i = 0; i < BINS-1; i++) {
-				currLeftCount += bin[i].triCount;
-				currLeftAabb.grow(bin[i].aabb);
-				leftArea[i] = currLeftAabb.area();
+			float leftArea[BINS - 1], rightArea[BINS - 1];
+			uint32_t leftCount[BINS - 1], rightCount[BINS - 1];
+			Lane4 leftMin = Splat4(FLT_MAX), leftMax = Splat4(-FLT_MAX);
+			Lane4 rightMin = Splat4(FLT_MAX), rightMax = Splat4(-FLT_MAX);
+			uint32_t currLeftCount = 0, currRightCount = 0;
+			for (uint32_t i = 0; i < BINS - 1; i++) {
+				const Bin4& lBin = bins[axis][i];
+				currLeftCount += lBin.triCount;
+				leftMin = Min4(leftMin, lBin.boxMin);
+				leftMax = Max4(leftMax, lBin.boxMax);
+				leftArea[i] = Area4(leftMin, leftMax);
 				leftCount[i] = currLeftCount;
 
-				currRightCount += bin[BINS - 1 - i].triCount;
-				currRightAabb.grow(bin[BINS - 1 - i].aabb);
+				const Bin4& rBin = bins[axis][BINS - 1 - i];
+				currRightCount += rBin.triCount;
+				rightMin = Min4(rightMin, rBin.boxMin);
+				rightMax = Max4(rightMax, rBin.boxMax);
 				// -2 because left/rightArea have size = BINS - 1
-				rightArea[BINS - 2 - i] = currRightAabb.area();
+				rightArea[BINS - 2 - i] = Area4(rightMin, rightMax);
 				rightCount[BINS - 2 - i] = currRightCount;
 			}
 
-			scale = (aabbMax - aabbMin) / BINS;
-			for (int i = 0; i < BINS - 1; i++) {
+			for (uint32_t i = 0; i < BINS - 1; i++) {
+				if (leftCount[i] == 0 || rightCount[i] == 0) {
+					continue; // empty side, not a real split
+				}
 				float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
-				if (cost < bestCost) {
-					splitAxis = axis;
-					splitPos = aabbMin + scale * (i + 1);
-					bestCost = cost;
+				if (cost < split.cost) {
+					split.cost = cost;
+					split.axis = axis;
+					split.lastLeftBin = i;
 				}
 			}
 		}
-		return bestCost;
+
+		if (split.axis < 0) {
+			return false;
+		}
+
+		// merge the child bounds out of the winning axis' bins
+		Lane4 leftMin = Splat4(FLT_MAX), leftMax = Splat4(-FLT_MAX);
+		Lane4 rightMin = Splat4(FLT_MAX), rightMax = Splat4(-FLT_MAX);
+		for (uint32_t i = 0; i < BINS; i++) {
+			const Bin4& bin = bins[split.axis][i];
+			if (i <= split.lastLeftBin) {
+				leftMin = Min4(leftMin, bin.boxMin);
+				leftMax = Max4(leftMax, bin.boxMax);
+			} else {
+				rightMin = Min4(rightMin, bin.boxMin);
+				rightMax = Max4(rightMax, bin.boxMax);
+			}
+		}
+		split.leftAabb = Aabb(ToVec3(leftMin), ToVec3(leftMax));
+		split.rightAabb = Aabb(ToVec3(rightMin), ToVec3(rightMax));
+		split.binOrigin = origin;
+		split.binScale = scale;
+		return true;
 	}
 
-	void BVHAccel::SubDivide(Node& node) {
-		int bestAxis = -1;
-		float bestPos = 0;
-		float bestCost = FindBestSplitPlane(node, bestAxis, bestPos);
+	bool BVHAccel::Split(const Node& node, const Aabb& centroidBounds,
+						 Node& leftChild, Aabb& leftCentroids, Node& rightChild, Aabb& rightCentroids) {
+		if (node.triCount <= 1) {
+			return false;
+		}
 
+		SplitPlane split;
 		Aabb parentAabb{ node.min, node.max };
 		float parentCost = node.triCount * parentAabb.area();
-		if (bestCost >= parentCost) {
-			return;
+		if (!FindObjectSplit(node, centroidBounds, split) || split.cost >= parentCost) {
+			return false;
 		}
 
-		uint32_t leftPtr = node.leftChild_Or_FirstTri; // points to the firstTri in node's triangles
-		uint32_t rightPtr = node.leftChild_Or_FirstTri + node.triCount - 1; // points to the lastTri
+		return PartitionObjectSplit(node, split, leftChild, leftCentroids, rightChild, rightCentroids);
+	}
 
-		// partition/sort the triangles (quicksort partition)
+	bool BVHAccel::FindObjectSplit(const Node& node, const Aabb& centroidBounds, SplitPlane& split) const {
+		switch (m_Options.binCount) {
+			case 32: return FindBestSplitPlane<32>(node, centroidBounds, split);
+			case 16: return FindBestSplitPlane<16>(node, centroidBounds, split);
+			default: return FindBestSplitPlane<8>(node, centroidBounds, split);
+		}
+	}
+
+	bool BVHAccel::PartitionObjectSplit(const Node& node, const SplitPlane& split,
+										Node& leftChild, Aabb& leftCentroids, Node& rightChild, Aabb& rightCentroids) {
+		// partition/sort the triangles (quicksort partition) using the exact binning arithmetic,
+		// so the children match the bin contents (and bounds) the split was chosen from
+		const int axis = split.axis;
+		const float binOrigin = split.binOrigin[axis], binScale = split.binScale[axis];
+		const float maxBin = float(m_Options.binCount - 1);
+		int leftPtr = node.leftChild_Or_FirstTri; // points to the firstTri in node's triangles
+		int rightPtr = node.leftChild_Or_FirstTri + node.triCount - 1; // points to the lastTri
+		Lane4 leftCMin = Splat4(FLT_MAX), leftCMax = Splat4(-FLT_MAX);
+		Lane4 rightCMin = Splat4(FLT_MAX), rightCMax = Splat4(-FLT_MAX);
 		while (leftPtr <= rightPtr) {
-			if (m_Centroids[m_IdxBuff[leftPtr]][bestAxis] < bestPos) {
+			const Lane4 centroid = Load4(m_Centroids[leftPtr]);
+			const float binPos = std::min(std::max((m_Centroids[leftPtr][axis] - binOrigin) * binScale, 0.0f), maxBin);
+			if (int(binPos) <= int(split.lastLeftBin)) {
+				leftCMin = Min4(leftCMin, centroid);
+				leftCMax = Max4(leftCMax, centroid);
 				leftPtr++;
 			}
 			else {
+				rightCMin = Min4(rightCMin, centroid);
+				rightCMax = Max4(rightCMax, centroid);
 				Swap(leftPtr, rightPtr--); // swap and decrement right
 			}
 		}
 
-		int leftTriCount = leftPtr - node.leftChild_Or_FirstTri; // distance between firstTri and partition point
+		uint32_t leftTriCount = leftPtr - node.leftChild_Or_FirstTri; // distance between firstTri and partition point
 		
 		// couldn't partition
 		if (leftTriCount == 0 || leftTriCount == node.triCount) {
+			return false;
+		}
+
+		// populate children, bounds carried over from the bins
+		leftChild.leftChild_Or_FirstTri = node.leftChild_Or_FirstTri;
+		leftChild.triCount = leftTriCount;
+		leftChild.min = split.leftAabb.boxMin;
+		leftChild.max = split.leftAabb.boxMax;
+		leftCentroids = Aabb(ToVec3(leftCMin), ToVec3(leftCMax));
+
+		rightChild.leftChild_Or_FirstTri = node.leftChild_Or_FirstTri + leftTriCount;
+		rightChild.triCount = node.triCount - leftTriCount;
+		rightChild.min = split.rightAabb.boxMin;
+		rightChild.max = split.rightAabb.boxMax;
+		rightCentroids = Aabb(ToVec3(rightCMin), ToVec3(rightCMax));
+		return true;
+	}
+
+	void BVHAccel::SubDivide(std::vector<Node>& nodes, uint32_t nodeIdx, const Aabb& centroidBounds) {
+		Node leftChild{}, rightChild{};
+		Aabb leftCentroids, rightCentroids;
+		if (!Split(nodes[nodeIdx], centroidBounds, leftChild, leftCentroids, rightChild, rightCentroids)) {
 			return;
 		}
 
-		// find indices for the new child nodes
-		int leftChildIdx = m_NodesUsed++;
-		int rightChildIdx = m_NodesUsed++;
+		// find indices for the new child nodes (push_back may reallocate - only hold indices)
+		uint32_t leftChildIdx = nodes.size();
+		nodes.push_back(leftChild);
+		nodes.push_back(rightChild);
 
-		// populate children
-		m_NodeBuff[leftChildIdx].leftChild_Or_FirstTri = node.leftChild_Or_FirstTri;
-		m_NodeBuff[leftChildIdx].triCount = leftTriCount;
-		m_NodeBuff[rightChildIdx].leftChild_Or_FirstTri = node.leftChild_Or_FirstTri + leftTriCount;
-		m_NodeBuff[rightChildIdx].triCount = node.triCount - leftTriCount;
-		node.triCount = 0; // ! mark the node as non-leaf node
-		node.leftChild_Or_FirstTri = leftChildIdx; // now points to the leftChild node
+		nodes[nodeIdx].triCount = 0; // ! mark the node as non-leaf node
+		nodes[nodeIdx].leftChild_Or_FirstTri = leftChildIdx; // now points to the leftChild node
 
-		UpdateAABB(m_NodeBuff[leftChildIdx]); // figure out bounds based on the recently added triangle indices and counts
-		UpdateAABB(m_NodeBuff[rightChildIdx]);
-		
-		SubDivide(m_NodeBuff[leftChildIdx]);
-		SubDivide(m_NodeBuff[rightChildIdx]);
+		SubDivide(nodes, leftChildIdx, leftCentroids);
+		SubDivide(nodes, leftChildIdx + 1, rightCentroids);
+	}
+
+	void BVHAccel::SubDivideParallel(BuildTask& task) {
+		if (task.node.triCount < m_Options.parallelCutoff) {
+			task.subtree.reserve(2 * task.node.triCount - 1);
+			task.subtree.push_back(task.node);
+			SubDivide(task.subtree, 0, task.centroidBounds);
+			return;
+		}
+
+		Node leftChild{}, rightChild{};
+		Aabb leftCentroids, rightCentroids;
+		if (!Split(task.node, task.centroidBounds, leftChild, leftCentroids, rightChild, rightCentroids)) {
+			task.subtree.push_back(task.node); // stays a leaf
+			return;
+		}
+
+		task.left = std::make_unique<BuildTask>();
+		task.left->node = leftChild;
+		task.left->centroidBounds = leftCentroids;
+		task.right = std::make_unique<BuildTask>();
+		task.right->node = rightChild;
+		task.right->centroidBounds = rightCentroids;
+
+		// children own disjoint index ranges, so they can be built concurrently
+		ThreadPool& pool = ThreadPool::Get();
+		ThreadPool::JobCounter counter;
+		pool.Submit([this, &task]() { SubDivideParallel(*task.left); }, counter);
+		SubDivideParallel(*task.right);
+		pool.Wait(counter);
+	}
+
+	uint32_t BVHAccel::CountDescendants(const BuildTask& task) const {
+		if (!task.subtree.empty()) {
+			return task.subtree.size() - 1;
+		}
+		return 2 + CountDescendants(*task.left) + CountDescendants(*task.right);
+	}
+
+	void BVHAccel::EmitTask(const BuildTask& task, Node* nodes, uint32_t selfIdx, uint32_t& nextFreeIdx) const {
+		if (!task.subtree.empty()) {
+			// subtree-local index k (k >= 1) lands at nextFreeIdx + k - 1
+			const uint32_t base = nextFreeIdx - 1;
+			for (uint32_t k = 0; k < task.subtree.size(); k++) {
+				Node node = task.subtree[k];
+				if (node.triCount == 0) {
+					node.leftChild_Or_FirstTri += base;
+				}
+				nodes[(k == 0) ? selfIdx : base + k] = node;
+			}
+			nextFreeIdx += task.subtree.size() - 1;
+			return;
+		}
+
+		// same order as SubDivide(): child pair first, then the whole left subtree, then the right one
+		const uint32_t leftChildIdx = nextFreeIdx;
+		nextFreeIdx += 2;
+
+		Node node = task.node;
+		node.triCount = 0;
+		node.leftChild_Or_FirstTri = leftChildIdx;
+		nodes[selfIdx] = node;
+
+		EmitTask(*task.left, nodes, leftChildIdx, nextFreeIdx);
+		EmitTask(*task.right, nodes, leftChildIdx + 1, nextFreeIdx);
+	}
+
+
+	// SPATIAL SPLITS (SBVH) ------------------------------------------------------------------
+
+	void BVHAccel::SubDivideSpatial(std::vector<Node>& nodes, uint32_t nodeIdx, const Aabb& centroidBounds, std::vector<uint32_t>& leafIndices) {
+		Node leftChild{}, rightChild{};
+		Aabb leftCentroids, rightCentroids;
+		if (!SplitSpatial(nodes[nodeIdx], centroidBounds, leftChild, leftCentroids, rightChild, rightCentroids)) {
+			// leaf - move its references out of the stack
+			Node& leaf = nodes[nodeIdx];
+			const uint32_t firstRef = leaf.leftChild_Or_FirstTri;
+			leaf.leftChild_Or_FirstTri = leafIndices.size();
+			leafIndices.insert(leafIndices.end(), m_IdxBuff + firstRef, m_IdxBuff + firstRef + leaf.triCount);
+			m_RefTop = firstRef;
+			return;
+		}
+
+		uint32_t leftChildIdx = nodes.size();
+		nodes.push_back(leftChild);
+		nodes.push_back(rightChild);
+
+		nodes[nodeIdx].triCount = 0; // ! mark the node as non-leaf node
+		nodes[nodeIdx].leftChild_Or_FirstTri = leftChildIdx;
+
+		// right child first - its references (and any duplicates) are the top of the stack
+		SubDivideSpatial(nodes, leftChildIdx + 1, rightCentroids, leafIndices);
+		SubDivideSpatial(nodes, leftChildIdx, leftCentroids, leafIndices);
+	}
+
+	bool BVHAccel::SplitSpatial(const Node& node, const Aabb& centroidBounds,
+								Node& leftChild, Aabb& leftCentroids, Node& rightChild, Aabb& rightCentroids) {
+		if (node.triCount <= 1) {
+			return false;
+		}
+
+		SplitPlane objectSplit;
+		const bool foundObject = FindObjectSplit(node, centroidBounds, objectSplit);
+
+		SpatialSplit spatialSplit;
+		bool foundSpatial = false;
+		if (m_DuplicatesLeft > 0) {
+			// spatial splits only pay off where the object split children overlap noticeably
+			float overlap = 0.0f;
+			if (foundObject) {
+				Aabb overlapAabb(glm::max(objectSplit.leftAabb.boxMin, objectSplit.rightAabb.boxMin),
+								 glm::min(objectSplit.leftAabb.boxMax, objectSplit.rightAabb.boxMax));
+				overlap = SafeArea(overlapAabb);
+			}
+			if (!foundObject || overlap > m_Options.spatialSplitAlpha * m_RootArea) {
+				switch (m_Options.binCount) {
+					case 32: foundSpatial = FindBestSpatialSplit<32>(node, spatialSplit); break;
+					case 16: foundSpatial = FindBestSpatialSplit<16>(node, spatialSplit); break;
+					default: foundSpatial = FindBestSpatialSplit<8>(node, spatialSplit); break;
+				}
+			}
+		}
+
+		Aabb parentAabb{ node.min, node.max };
+		float parentCost = node.triCount * parentAabb.area();
+		const float objectCost = foundObject ? objectSplit.cost : FLT_MAX;
+		if (foundSpatial && spatialSplit.cost < objectCost && spatialSplit.cost < parentCost &&
+			PartitionSpatialSplit(node, spatialSplit, leftChild, rightChild)) {
+			// clipped references - recompute the child bounds from them
+			UpdateAABB(leftChild, leftCentroids);
+			UpdateAABB(rightChild, rightCentroids);
+			return true;
+		}
+
+		if (!foundObject || objectCost >= parentCost) {
+			return false;
+		}
+		return PartitionObjectSplit(node, objectSplit, leftChild, leftCentroids, rightChild, rightCentroids);
+	}
+
+	template <uint32_t BINS>
+	bool BVHAccel::FindBestSpatialSplit(const Node& node, SpatialSplit& split) const {
+		const glm::vec3 extent = node.max - node.min;
+		split.cost = FLT_MAX;
+
+		for (int axis = 0; axis < 3; axis++) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+			const float origin = node.min[axis];
+			const float binSize = extent[axis] / BINS;
+			const float invBinSize = BINS / extent[axis];
+
+			// chop every reference into the bins it overlaps
+			SpatialBin bins[BINS];
+			for (uint32_t i = 0; i < node.triCount; i++) {
+				const uint32_t refIdx = node.leftChild_Or_FirstTri + i;
+				Aabb refBounds(glm::vec3(m_TriMin[refIdx]), glm::vec3(m_TriMax[refIdx]));
+				const int firstBin = std::clamp(int((refBounds.boxMin[axis] - origin) * invBinSize), 0, int(BINS - 1));
+				const int lastBin = std::clamp(int((refBounds.boxMax[axis] - origin) * invBinSize), firstBin, int(BINS - 1));
+
+				for (int b = firstBin; b < lastBin; b++) {
+					Aabb left, right;
+					SplitReference(m_IdxBuff[refIdx], refBounds, axis, origin + binSize * (b + 1), left, right);
+					bins[b].bounds.grow(left);
+					refBounds = right;
+				}
+				bins[lastBin].bounds.grow(refBounds);
+				bins[firstBin].enterCount++;
+				bins[lastBin].exitCount++;
+			}
+
+			// sweep like the object split, left counts references entering and right ones leaving
+			float leftArea[BINS - 1], rightArea[BINS - 1];
+			uint32_t leftCount[BINS - 1], rightCount[BINS - 1];
+			Aabb leftBox, rightBox;
+			uint32_t currLeftCount = 0, currRightCount = 0;
+			for (uint32_t i = 0; i < BINS - 1; i++) {
+				currLeftCount += bins[i].enterCount;
+				leftBox.grow(bins[i].bounds);
+				leftArea[i] = SafeArea(leftBox);
+				leftCount[i] = currLeftCount;
+
+				currRightCount += bins[BINS - 1 - i].exitCount;
+				rightBox.grow(bins[BINS - 1 - i].bounds);
+				rightArea[BINS - 2 - i] = SafeArea(rightBox);
+				rightCount[BINS - 2 - i] = currRightCount;
+			}
+
+			for (uint32_t i = 0; i < BINS - 1; i++) {
+				if (leftCount[i] == 0 || rightCount[i] == 0) {
+					continue;
+				}
+				float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+				if (cost < split.cost) {
+					split.cost = cost;
+					split.axis = axis;
+					split.position = origin + binSize * (i + 1);
+					split.leftCount = leftCount[i];
+					split.rightCount = rightCount[i];
+				}
+			}
+		}
+		return split.axis >= 0;
+	}
+
+	void BVHAccel::SplitReference(uint32_t triIdx, const Aabb& refBounds, int axis, float position, Aabb& left, Aabb& right) const {
+		left = Aabb();
+		right = Aabb();
+
+		glm::vec3 verts[3];
+		m_Triangles.Fetch(triIdx, verts[0], verts[1], verts[2]);
+		for (int i = 0; i < 3; i++) {
+			const glm::vec3& v0 = verts[i];
+			const glm::vec3& v1 = verts[(i + 1) % 3];
+			const float p0 = v0[axis], p1 = v1[axis];
+			if (p0 <= position) left.grow(v0);
+			if (p0 >= position) right.grow(v0);
+
+			// edge crosses the plane, both halves get the intersection point
+			if ((p0 < position && p1 > position) || (p0 > position && p1 < position)) {
+				const glm::vec3 t = glm::mix(v0, v1, glm::clamp((position - p0) / (p1 - p0), 0.0f, 1.0f));
+				left.grow(t);
+				right.grow(t);
+			}
+		}
+
+		left.boxMax[axis] = position;
+		right.boxMin[axis] = position;
+
+		// the reference may already be clipped by earlier splits
+		left.boxMin = glm::max(left.boxMin, refBounds.boxMin);
+		left.boxMax = glm::min(left.boxMax, refBounds.boxMax);
+		right.boxMin = glm::max(right.boxMin, refBounds.boxMin);
+		right.boxMax = glm::min(right.boxMax, refBounds.boxMax);
+	}
+
+	bool BVHAccel::PartitionSpatialSplit(const Node& node, const SpatialSplit& split, Node& leftChild, Node& rightChild) {
+		const int axis = split.axis;
+		const float position = split.position;
+		const int firstRef = node.leftChild_Or_FirstTri;
+
+		// [firstRef, leftEnd) left only, [leftEnd, rightStart) straddling, [rightStart, end) right only
+		int leftEnd = firstRef;
+		int rightStart = firstRef + node.triCount;
+		Aabb leftBounds, rightBounds;
+		for (int i = leftEnd; i < rightStart; i++) {
+			if (m_TriMax[i][axis] <= position) {
+				leftBounds.grow(Aabb(glm::vec3(m_TriMin[i]), glm::vec3(m_TriMax[i])));
+				Swap(i, leftEnd++);
+			}
+			else if (m_TriMin[i][axis] >= position) {
+				rightBounds.grow(Aabb(glm::vec3(m_TriMin[i]), glm::vec3(m_TriMax[i])));
+				Swap(i--, --rightStart);
+			}
+		}
+
+		// straddling references go left, right or get duplicated - whichever is cheapest (SBVH "reference unsplitting")
+		const float leftCount = float(split.leftCount), rightCount = float(split.rightCount);
+		while (leftEnd < rightStart) {
+			const Aabb refBounds(glm::vec3(m_TriMin[leftEnd]), glm::vec3(m_TriMax[leftEnd]));
+			Aabb leftRef, rightRef;
+			SplitReference(m_IdxBuff[leftEnd], refBounds, axis, position, leftRef, rightRef);
+
+			Aabb leftUnsplit = leftBounds, rightUnsplit = rightBounds;
+			leftUnsplit.grow(refBounds);
+			rightUnsplit.grow(refBounds);
+			Aabb leftDuplicate = leftBounds, rightDuplicate = rightBounds;
+			leftDuplicate.grow(leftRef);
+			rightDuplicate.grow(rightRef);
+
+			const float unsplitLeftCost = SafeArea(leftUnsplit) * leftCount + SafeArea(rightBounds) * std::max(rightCount - 1.0f, 0.0f);
+			const float unsplitRightCost = SafeArea(leftBounds) * std::max(leftCount - 1.0f, 0.0f) + SafeArea(rightUnsplit) * rightCount;
+			const float duplicateCost = (m_DuplicatesLeft > 0 && m_RefTop < m_RefTris.size())
+				? SafeArea(leftDuplicate) * leftCount + SafeArea(rightDuplicate) * rightCount
+				: FLT_MAX;
+
+			if (duplicateCost < unsplitLeftCost && duplicateCost < unsplitRightCost) {
+				// left half replaces the reference, right half is pushed on top of the stack
+				m_TriMin[leftEnd] = glm::vec4(leftRef.boxMin, 0.0f);
+				m_TriMax[leftEnd] = glm::vec4(leftRef.boxMax, 0.0f);
+				m_Centroids[leftEnd] = (m_TriMin[leftEnd] + m_TriMax[leftEnd]) * 0.5f;
+
+				m_IdxBuff[m_RefTop] = m_IdxBuff[leftEnd];
+				m_TriMin[m_RefTop] = glm::vec4(rightRef.boxMin, 0.0f);
+				m_TriMax[m_RefTop] = glm::vec4(rightRef.boxMax, 0.0f);
+				m_Centroids[m_RefTop] = (m_TriMin[m_RefTop] + m_TriMax[m_RefTop]) * 0.5f;
+				m_RefTop++;
+				m_DuplicatesLeft--;
+
+				leftBounds = leftDuplicate;
+				rightBounds = rightDuplicate;
+				leftEnd++;
+			}
+			else if (unsplitLeftCost <= unsplitRightCost) {
+				leftBounds = leftUnsplit;
+				leftEnd++;
+			}
+			else {
+				rightBounds = rightUnsplit;
+				Swap(leftEnd, --rightStart);
+			}
+		}
+
+		// duplicates only ever add to both sides, so an empty side means nothing was pushed
+		const uint32_t leftRefCount = leftEnd - firstRef;
+		const uint32_t rightRefCount = m_RefTop - leftEnd;
+		if (leftRefCount == 0 || rightRefCount == 0) {
+			return false;
+		}
+
+		leftChild.leftChild_Or_FirstTri = firstRef;
+		leftChild.triCount = leftRefCount;
+		rightChild.leftChild_Or_FirstTri = leftEnd;
+		rightChild.triCount = rightRefCount;
+		return true;
 	}
-}
\ No newline at end of file
+}
@@ -1,8 +1,10 @@
 // Thanks to: https://jacco.ompf2.com/2022/04/13/how-to-build-a-bvh-part-1-basics
+// Spatial splits: Stich et al. 2009 "Spatial Splits in Bounding Volume Hierarchies" and Aila & Laine's SplitBVHBuilder
 #pragma once
 
 #include "lrpch.h"
 #include "Project/Assets/AssetTypes.h"
+#include <numeric> // std::iota
 
 namespace X3
 {
@@ -19,6 +21,28 @@ namespace X3
 				else leftChild_Or_FirstTri == firstTri */
 		};
 
+		// std430 - 128 bytes. Collapsed (wide) BVHs store their nodes as packets of 4 children in structure
+		// of arrays layout, so the shader slab-tests 4 children at once. A node of width N spans N/4 packets.
+		struct WidePacket {
+			glm::vec4 minX, minY, minZ;
+			glm::vec4 maxX, maxY, maxZ;
+			glm::uvec4 child;		// inner: first packet of the child node, leaf: first index (as Node::leftChild_Or_FirstTri)
+			glm::uvec4 triCount;	// 0 for inner children
+		};
+		static constexpr uint32_t WIDE_EMPTY_SLOT = 0xFFFFFFFF; // WidePacket::child of unused slots
+
+		// std430 - 80 bytes. WidePacket with the child bounds quantized to 8 bits on a grid over the packet's bounds,
+		// child i is stored in bits [8i, 8i + 8) of the q* fields. Decoded bounds (origin + q * scale) always enclose the originals.
+		struct QuantizedPacket {
+			glm::vec3 origin;
+			uint32_t qMinX;
+			glm::vec3 scale;		// powers of two, decoding is exact in float (no fma dependent rounding)
+			uint32_t qMinY;
+			glm::uvec4 qMinZ_MaxXYZ;
+			glm::uvec4 child;		// as WidePacket
+			glm::uvec4 triCount;
+		};
+
 		struct Aabb {
 			glm::vec3 boxMin;
 			glm::vec3 boxMax;
@@ -36,57 +60,270 @@ namespace X3
 				boxMax = glm::max(boxMax, aabb.boxMax);
 			}
 
-			float area() { 
+			float area() const { 
 				glm::vec3 s = boxMax - boxMin; // box size
 				return s.x * s.y + s.y * s.z + s.z * s.x; // no * 2 as constants don't matter
 			}
 		};
 
-		struct Bin {
-			Aabb aabb;
-			int triCount = 0;
+		// Read-only view of one mesh's triangles, stored either as standalone Triangles or as Faces over shared vertices.
+		// Triangle indices are mesh local, the view must not outlive (or see reallocations of) the viewed buffers.
+		class TriangleView {
+		public:
+			TriangleView(const std::vector<Triangle>& meshBuffer, uint32_t firstTriIdx, bool precomputed = false)
+			: m_Triangles(meshBuffer.data() + firstTriIdx), m_Precomputed(precomputed) {}
+			TriangleView(const std::vector<glm::vec3>& vertexBuffer, uint32_t firstVertexIdx, const std::vector<Face>& faceBuffer, uint32_t firstFaceIdx)
+			: m_Vertices(vertexBuffer.data() + firstVertexIdx), m_Faces(faceBuffer.data() + firstFaceIdx) {}
+
+			inline void Fetch(uint32_t triIdx, glm::vec3& v0, glm::vec3& v1, glm::vec3& v2) const {
+				if (m_Faces) {
+					const Face& face = m_Faces[triIdx];
+					v0 = m_Vertices[face.v0];
+					v1 = m_Vertices[face.v1];
+					v2 = m_Vertices[face.v2];
+				} else {
+					const Triangle tri = m_Precomputed ? FromPrecomputedTriangle(m_Triangles[triIdx]) : m_Triangles[triIdx];
+					v0 = glm::vec3(tri.v0);
+					v1 = glm::vec3(tri.v1);
+					v2 = glm::vec3(tri.v2);
+				}
+			}
+
+		private:
+			const Triangle* m_Triangles = nullptr;
+			const glm::vec3* m_Vertices = nullptr;
+			const Face* m_Faces = nullptr;
+			bool m_Precomputed = false;
 		};
 
-		BVHAccel(const std::vector<Triangle>& meshBuffer, const uint32_t firstTriIdx, const uint32_t triCount);
+		// Bump whenever Build() produces different trees (or layouts) for the same input - invalidates .lrgeo caches
+		static constexpr uint32_t BUILDER_VERSION = 2;
+
+		// OptimizeTreelets(): leaves per restructured treelet (2^7 subsets in the DP) and max. passes over the tree
+		static constexpr uint32_t TREELET_LEAF_COUNT = 7;
+		static constexpr uint32_t TREELET_PASSES = 3;
+
+		BVHAccel(const TriangleView& triangles, const uint32_t triCount);
+		BVHAccel(const std::vector<Triangle>& meshBuffer, const uint32_t firstTriIdx, const uint32_t triCount)
+		: BVHAccel(TriangleView(meshBuffer, firstTriIdx), triCount) {}
+		// Builds over arbitrary bounding boxes instead of triangles (e.g. the TLAS over entity bounds)
+		// leaves then index into 'primitiveBounds', spatial splits are not available
+		BVHAccel(const std::vector<Aabb>& primitiveBounds);
 		~BVHAccel() = default;
 
-		// Builds the Bounding Volume Hierarchy for a given Mesh using the UpdateAABB() & SubDivide() helper methods
-		void Build(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer, uint32_t& firstNodeIdx, uint32_t& nodeCount);
+		// Builds the Bounding Volume Hierarchy for a given Mesh using the UpdateAABB() & SubDivide() helper methods.
+		// Nodes and leaf indices are appended to the buffers, leaves index relative to 'firstIndexIdx'.
+		// Runs OptimizeTreelets() on the result if BVHBuildOptions::treeletOptimization is set.
+		void Build(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer,
+				   uint32_t& firstNodeIdx, uint32_t& nodeCount, uint32_t& firstIndexIdx, uint32_t& indexCount,
+				   const BVHBuildOptions& options = {});
+
+		// Linear BVH: sorts the triangles along a 30 bit Morton curve over their centroids and splits ranges
+		// where the highest differing code bit flips. A fraction of the binned SAH build time at lower tree
+		// quality, meant as a stand-in until Build() is done. Same output layout and conventions as Build().
+		void BuildLinear(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer,
+						 uint32_t& firstNodeIdx, uint32_t& nodeCount, uint32_t& firstIndexIdx, uint32_t& indexCount);
+
+		// Treelet restructuring (Karras & Aila 2013, "Fast Parallel Construction of High-Quality BVHs"): walks the tree
+		// bottom-up, grows a treelet of up to TREELET_LEAF_COUNT leaves below every interior node and replaces its
+		// topology by the SAH optimal one. Leaves (bounds & triangle ranges) and the node count are kept, the tree
+		// is re-emitted depth-first with its leaf index ranges repacked in that order - same layout as Build().
+		// Subtrees below 'parallelCutoff' triangles are optimized concurrently on the ThreadPool.
+		static void OptimizeTreelets(std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount,
+									 std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, uint32_t indexCount,
+									 bool parallel = true, uint32_t parallelCutoff = 8192);
+
+		// Recomputes the bounds of an already built tree bottom-up after its triangles moved (deforming meshes).
+		// Topology & leaf ranges are kept, relies on children being stored after their parent (as Build() does).
+		// Leaves of spatial split builds grow back to their whole triangles (still correct, just looser).
+		// Returns ComputeSAHInflation() of the refit tree, compare against the value after the build to decide when to rebuild
+		static float Refit(std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount,
+						   const std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, const TriangleView& triangles);
+
+		// SAH cost of a tree normalized by its root's surface area (interior nodes weigh 1, leaves their triCount)
+		static float ComputeSAHCost(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount);
+		// SAH cost normalized by the summed surface area of the referenced triangles' bounds instead of the root.
+		// Unlike ComputeSAHCost() it isn't skewed by a deformation changing the mesh's extent, so it stays comparable across refits
+		static float ComputeSAHInflation(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount,
+										 const std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, const TriangleView& triangles);
+
+		// Overwrites the tree statistics of 'report' (SAH cost, depths, leaf size histogram, sibling overlap)
+		// with those of a built tree. The builder name & phase times are left to the caller (see GetSetupTimeMs())
+		static void Analyze(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount, BVHQualityReport& report);
+
+		// Wall clock time of the constructor's per-triangle precomputation, of the last Build() / BuildLinear()
+		// (without the treelet pass) and of the last Build()'s OptimizeTreelets()
+		inline double GetSetupTimeMs() const { return m_SetupTimeMs; }
+		inline double GetBuildTimeMs() const { return m_BuildTimeMs; }
+		inline double GetOptimizeTimeMs() const { return m_OptimizeTimeMs; }
+
+		// Permutes the mesh's triangles (Triangles or Faces) into the order its leaves reference them and resets the
+		// index range to the identity, so leaf ranges index the triangles directly. Fails (changes nothing) if the
+		// index range isn't a permutation of the triangles, i.e. spatial splits duplicated references.
+		// 'triangleOrder' (if given) maps source triangles to their slot in the range (empty = identity) and is
+		// updated to where they end up.
+		template <typename T>
+		static bool ReorderTrianglesToLeafOrder(std::vector<T>& triangleBuffer, uint32_t firstTriIdx, uint32_t triCount,
+												std::vector<uint32_t>& indexBuffer, uint32_t firstIndexIdx, uint32_t indexCount,
+												std::vector<uint32_t>* triangleOrder = nullptr) {
+			if (indexCount != triCount) {
+				return false;
+			}
+
+			std::vector<T> leafOrdered(triCount);
+			std::vector<uint32_t> slotToLeaf(triangleOrder ? triCount : 0);
+			for (uint32_t i = 0; i < triCount; i++) {
+				leafOrdered[i] = triangleBuffer[firstTriIdx + indexBuffer[firstIndexIdx + i]];
+				if (triangleOrder) {
+					slotToLeaf[indexBuffer[firstIndexIdx + i]] = i;
+				}
+			}
+			std::copy(leafOrdered.begin(), leafOrdered.end(), triangleBuffer.begin() + firstTriIdx);
+			if (triangleOrder && triangleOrder->empty()) {
+				triangleOrder->swap(slotToLeaf);
+			} else if (triangleOrder) {
+				for (uint32_t& slot : *triangleOrder) {
+					slot = slotToLeaf[slot];
+				}
+			}
+			std::iota(indexBuffer.begin() + firstIndexIdx, indexBuffer.begin() + firstIndexIdx + indexCount, 0u);
+			return true;
+		}
+
+		// Collapses a built binary tree into an N-wide one (N = 4 or 8) by repeatedly opening the child with
+		// the largest surface area. Packets are appended to 'wideBuffer', child packet indices are relative to
+		// 'firstPacketIdx' and leaves keep their index ranges. The layout only depends on the binary topology,
+		// so collapsing a refit tree again yields the same packet count.
+		static void Collapse(const std::vector<Node>& nodeBuffer, uint32_t firstNodeIdx, uint32_t nodeCount, uint32_t width,
+							 std::vector<WidePacket>& wideBuffer, uint32_t& firstPacketIdx, uint32_t& packetCount);
+		// Conservatively quantizes a packet, the encoding doesn't change any indices
+		static QuantizedPacket Quantize(const WidePacket& packet);
 
 	private:
-		float FindBestSplitPlane(Node& node, int& axis, float& splitPos);
+		// Outcome of the binned SAH sweep - everything needed to partition the node and initialize its children
+		struct SplitPlane {
+			int axis = -1;
+			uint32_t lastLeftBin = 0;		// bins [0, lastLeftBin] go to the left child
+			float cost = FLT_MAX;
+			glm::vec4 binOrigin{}, binScale{}; // centroid -> bin mapping used while binning (per axis)
+			Aabb leftAabb, rightAabb;		// child bounds merged from the bins, no rescan needed
+		};
+
+		// Outcome of the spatial binning sweep (SBVH)
+		struct SpatialSplit {
+			int axis = -1;
+			float position = 0.0f;			// world space split plane along 'axis'
+			float cost = FLT_MAX;
+			uint32_t leftCount = 0, rightCount = 0; // reference counts including the duplicated ones
+		};
+
+		// Upper part of the tree built in parallel; below the cutoff a task holds its serially built subtree
+		struct BuildTask {
+			Node node{};
+			Aabb centroidBounds;
+			std::unique_ptr<BuildTask> left, right;	// set if the node was split by the task itself
+			std::vector<Node> subtree;				// else: [node, descendants...] with subtree-local child indices
+		};
+
+		// SAH Heuristic in O(n) time - bins all three axes in one pass over the precomputed triangle bounds
+		template <uint32_t BINS>
+		bool FindBestSplitPlane(const Node& node, const Aabb& centroidBounds, SplitPlane& split) const;
+
+		// Spatial split SAH - clips the node's references into bins of its bounds
+		template <uint32_t BINS>
+		bool FindBestSpatialSplit(const Node& node, SpatialSplit& split) const;
+		// Clips triangle 'triIdx', restricted to 'refBounds', against the plane and returns the bounds of both halves
+		void SplitReference(uint32_t triIdx, const Aabb& refBounds, int axis, float position, Aabb& left, Aabb& right) const;
 
-		float EvaluateSAH(Node& node, int axis, float candidatePos);
 		// Computes the Axis Aligned Bounding Box for a Node passed in using its triangles
-		void UpdateAABB(Node& node);
-		// Recursively splits the node using a split method, and sorts the triangle index array
-		void SubDivide(Node& node);
+		void UpdateAABB(Node& node, Aabb& centroidBounds) const;
+		// Picks a split for the node, partitions its triangle indices and initializes both children.
+		// Returns false if the node should stay a leaf. Only touches the node's own index range (thread safe).
+		bool Split(const Node& node, const Aabb& centroidBounds,
+				   Node& leftChild, Aabb& leftCentroids, Node& rightChild, Aabb& rightCentroids);
+		// Runs the binned object split SAH with the configured bin count
+		bool FindObjectSplit(const Node& node, const Aabb& centroidBounds, SplitPlane& split) const;
+		// Partitions the node's references according to the object split
+		bool PartitionObjectSplit(const Node& node, const SplitPlane& split,
+								  Node& leftChild, Aabb& leftCentroids, Node& rightChild, Aabb& rightCentroids);
+		// SBVH counterpart of Split(), picks the cheaper of the object and the spatial split
+		bool SplitSpatial(const Node& node, const Aabb& centroidBounds,
+						  Node& leftChild, Aabb& leftCentroids, Node& rightChild, Aabb& rightCentroids);
+		// Partitions the node's references by the plane, duplicating straddling ones where SAH says so.
+		// Duplicates are pushed on top of the reference stack (the right child's range)
+		bool PartitionSpatialSplit(const Node& node, const SpatialSplit& split, Node& leftChild, Node& rightChild);
+		// Build() without the treelet pass
+		void BuildTopDown(std::vector<Node>& nodeBuffer, std::vector<uint32_t>& indexBuffer,
+						  uint32_t& firstNodeIdx, uint32_t& nodeCount, uint32_t& firstIndexIdx, uint32_t& indexCount,
+						  const BVHBuildOptions& options);
+		// Recursively splits nodes[nodeIdx], appending the child pairs to 'nodes' in depth-first order
+		void SubDivide(std::vector<Node>& nodes, uint32_t nodeIdx, const Aabb& centroidBounds);
+		// SBVH counterpart of SubDivide() - the node's references are the top of the reference stack,
+		// leaves copy their triangle indices into 'leafIndices' and pop them
+		void SubDivideSpatial(std::vector<Node>& nodes, uint32_t nodeIdx, const Aabb& centroidBounds, std::vector<uint32_t>& leafIndices);
+		// LBVH counterpart of SubDivide() over the sorted Morton 'codes', only sets the topology (no bounds)
+		void SubDivideLinear(std::vector<Node>& nodes, uint32_t nodeIdx, const std::vector<uint32_t>& codes) const;
+		// Parallel counterpart of SubDivide(), forks the left child onto the ThreadPool above the cutoff
+		void SubDivideParallel(BuildTask& task);
+		// Number of nodes below the task's node (excluding the node itself)
+		uint32_t CountDescendants(const BuildTask& task) const;
+		// Writes the task tree into 'nodes' in the same depth-first order SubDivide() produces
+		void EmitTask(const BuildTask& task, Node* nodes, uint32_t selfIdx, uint32_t& nextFreeIdx) const;
 
-		inline const std::vector<glm::vec3> PrecomputeCentroids() const {
-			std::vector<glm::vec3> centroids;
+		// Centroids and bounds are padded to vec4 so the binning kernel can load all three axes at once
+		inline const std::vector<glm::vec4> PrecomputeCentroids() const {
+			std::vector<glm::vec4> centroids;
 			centroids.resize(m_TriCount);
-			for (int i = 0; i < m_TriCount; i++) {
-				const Triangle& t = m_TriBuff[m_FirstTriIdx + i];
-				centroids[i] = (t.v0 + t.v1 + t.v2) * 0.333333333333f;
+			for (uint32_t i = 0; i < m_TriCount; i++) {
+				glm::vec3 v0, v1, v2;
+				m_Triangles.Fetch(i, v0, v1, v2);
+				centroids[i] = glm::vec4((v0 + v1 + v2) * 0.333333333333f, 0.0f);
 			}
 			return centroids;
 		}
 
+		inline void PrecomputeTriBounds() {
+			m_TriMin.resize(m_TriCount);
+			m_TriMax.resize(m_TriCount);
+			for (uint32_t i = 0; i < m_TriCount; i++) {
+				glm::vec3 v0, v1, v2;
+				m_Triangles.Fetch(i, v0, v1, v2);
+				m_TriMin[i] = glm::vec4(glm::min(glm::min(v0, v1), v2), 0.0f);
+				m_TriMax[i] = glm::vec4(glm::max(glm::max(v0, v1), v2), 0.0f);
+			}
+		}
+
+		// keeps the per-triangle data in the same order as the index buffer
 		inline void Swap(int idx1, int idx2) {
-			uint32_t tmp = m_IdxBuff[idx1];
-			m_IdxBuff[idx1] = m_IdxBuff[idx2];
-			m_IdxBuff[idx2] = tmp;
+			std::swap(m_IdxBuff[idx1], m_IdxBuff[idx2]);
+			std::swap(m_Centroids[idx1], m_Centroids[idx2]);
+			std::swap(m_TriMin[idx1], m_TriMin[idx2]);
+			std::swap(m_TriMax[idx1], m_TriMax[idx2]);
 		}
 		
 		// passed into the constructor
-		const std::vector<Triangle>& m_TriBuff;
-		const uint32_t m_FirstTriIdx;
+		const TriangleView m_Triangles;
+		const bool m_HasTriangles;	// false for builds over bounding boxes
 		const uint32_t m_TriCount;
 
-		std::vector<glm::vec3> m_Centroids;
+		// structure of arrays, indexed like the index buffer range (starts as the mesh local triangle index)
+		// and permuted alongside it, so every node's triangles are read sequentially
+		std::vector<glm::vec4> m_Centroids;
+		std::vector<glm::vec4> m_TriMin, m_TriMax;
+
+		static constexpr uint32_t LBVH_MAX_LEAF_SIZE = 4;
 
-		uint32_t m_NodesUsed = 0;
-		Node* m_NodeBuff = nullptr;
+		BVHBuildOptions m_Options;
 		uint32_t* m_IdxBuff = nullptr;
+
+		// SBVH only: references can outnumber triangles, so they live in their own (preallocated) stack
+		std::vector<uint32_t> m_RefTris;
+		uint32_t m_RefTop = 0;				// one past the last live reference
+		uint32_t m_DuplicatesLeft = 0;		// remaining duplication budget
+		float m_RootArea = 0.0f;
+
+		double m_SetupTimeMs = 0.0;
+		double m_BuildTimeMs = 0.0;
+		double m_OptimizeTimeMs = 0.0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "Project/Assets/RangeAllocator.h"
+
+namespace X3
+{
+
+	std::optional<uint32_t> RangeAllocator::Allocate(uint32_t count) {
+		if (count == 0) {
+			return std::nullopt;
+		}
+		for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it) {
+			if (it->second < count) {
+				continue;
+			}
+			const uint32_t first = it->first;
+			const uint32_t remaining = it->second - count;
+			m_FreeRanges.erase(it);
+			if (remaining != 0) {
+				m_FreeRanges.emplace(first + count, remaining);
+			}
+			m_FreeCount -= count;
+			return first;
+		}
+		return std::nullopt;
+	}
+
+	bool RangeAllocator::Claim(uint32_t first, uint32_t count) {
+		// the free range starting at or before 'first'
+		auto it = m_FreeRanges.upper_bound(first);
+		if (it == m_FreeRanges.begin()) {
+			return false;
+		}
+		--it;
+		const uint32_t freeFirst = it->first;
+		const uint32_t freeEnd = it->first + it->second;
+		if (first + count > freeEnd) {
+			return false;
+		}
+
+		m_FreeRanges.erase(it);
+		if (first > freeFirst) {
+			m_FreeRanges.emplace(freeFirst, first - freeFirst);
+		}
+		if (first + count < freeEnd) {
+			m_FreeRanges.emplace(first + count, freeEnd - (first + count));
+		}
+		m_FreeCount -= count;
+		return true;
+	}
+
+	void RangeAllocator::Free(uint32_t first, uint32_t count) {
+		if (count == 0) {
+			return;
+		}
+		m_FreeCount += count;
+
+		auto next = m_FreeRanges.lower_bound(first);
+		if (next != m_FreeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == first) { // merge with the range before
+				first = prev->first;
+				count += prev->second;
+				m_FreeRanges.erase(prev);
+			}
+		}
+		if (next != m_FreeRanges.end() && first + count == next->first) { // and the one after
+			count += next->second;
+			m_FreeRanges.erase(next);
+		}
+		m_FreeRanges.emplace(first, count);
+	}
+
+	void RangeAllocator::Truncate(uint32_t bufferSize) {
+		for (auto it = m_FreeRanges.lower_bound(bufferSize); it != m_FreeRanges.end();) {
+			m_FreeCount -= it->second;
+			it = m_FreeRanges.erase(it);
+		}
+		// a range straddling the new end keeps only its part below it
+		if (!m_FreeRanges.empty()) {
+			auto last = std::prev(m_FreeRanges.end());
+			if (last->first + last->second > bufferSize) {
+				m_FreeCount -= last->first + last->second - bufferSize;
+				last->second = bufferSize - last->first;
+			}
+		}
+	}
+
+	std::optional<RangeAllocator::Range> RangeAllocator::GetFirstFreeRange() const {
+		if (m_FreeRanges.empty()) {
+			return std::nullopt;
+		}
+		return Range{ m_FreeRanges.begin()->first, m_FreeRanges.begin()->second };
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "lrpch.h"
+#include <map>
+#include <optional>
+
+namespace X3
+{
+
+	// ============================================================================
+	// RANGE ALLOCATOR
+	// ----------------------------------------------------------------------------
+	// Free list over the elements of one AssetPool buffer. Only tracks the holes,
+	// the buffer itself (and its size) stays with the owner: ranges freed by
+	// removed assets or replaced BVHs are handed out again (first fit) before the
+	// buffer has to grow. Adjacent free ranges are merged.
+	// ============================================================================
+	class RangeAllocator {
+	public:
+		struct Range {
+			uint32_t first;
+			uint32_t count;
+		};
+
+		/// Takes 'count' elements from the lowest free range large enough.
+		/// Returns std::nullopt if there is none, the caller appends to the buffer instead.
+		std::optional<uint32_t> Allocate(uint32_t count);
+
+		/// Takes exactly [first, first + count), which has to lie within one free range.
+		/// Returns false (and changes nothing) if it doesn't.
+		bool Claim(uint32_t first, uint32_t count);
+
+		/// Returns [first, first + count) to the free list, merged with its free neighbours.
+		void Free(uint32_t first, uint32_t count);
+
+		/// Drops all free ranges starting at or above 'bufferSize' (the owner shrank the buffer).
+		void Truncate(uint32_t bufferSize);
+
+		/// Lowest free range, std::nullopt if there are no holes
+		std::optional<Range> GetFirstFreeRange() const;
+		inline uint64_t GetFreeCount() const { return m_FreeCount; }
+		inline size_t GetFreeRangeCount() const { return m_FreeRanges.size(); }
+
+	private:
+		std::map<uint32_t, uint32_t> m_FreeRanges; // first -> count, never adjacent or overlapping
+		uint64_t m_FreeCount = 0;
+	};
+}
@@ -12,6 +12,12 @@ namespace X3
 		  m_MatrixDirty(true) {
 	}
 
+	void TransformComponent::MarkDirty() {
+		static std::atomic<uint32_t> s_VersionCounter{ 0 };
+		m_Version = ++s_VersionCounter;
+		m_MatrixDirty = true;
+	}
+
 	TransformComponent::operator glm::mat4() const {
 		return GetMatrix();
 	}
@@ -29,31 +35,31 @@ namespace X3
 
 	void TransformComponent::SetRotation(const glm::vec3& euler) {
 		m_Rotation = glm::radians(euler);
-		m_MatrixDirty = true;
+		MarkDirty();
 	}
 
 	void TransformComponent::SetTranslation(const glm::vec3& translation) {
 		m_Translation = translation;
-		m_MatrixDirty = true;
+		MarkDirty();
 	}
 
 	void TransformComponent::SetScale(const glm::vec3& scale) {
 		m_Scale = scale;
-		m_MatrixDirty = true;
+		MarkDirty();
 	}
 
 	void TransformComponent::IncrementRotation(const glm::vec3& delta) {
 		m_Rotation += glm::radians(delta);
-		m_MatrixDirty = true;
+		MarkDirty();
 	}
 
 	void TransformComponent::IncrementTranslation(const glm::vec3& delta) {
 		m_Translation += delta;
-		m_MatrixDirty = true;
+		MarkDirty();
 	}
 
 	void TransformComponent::IncrementScale(const glm::vec3& delta) {
 		m_Scale += delta;
-		m_MatrixDirty = true;
+		MarkDirty();
 	}
 }
\ No newline at end of file
@@ -44,7 +44,14 @@ namespace X3
 		void IncrementTranslation(const glm::vec3& delta);
 		void IncrementScale(const glm::vec3& delta);
 
+		// Changes on every modification and is unique across all transforms (0 = never modified),
+		// so listeners like the renderer can detect moved entities by comparing against a cached value
+		inline uint32_t GetVersion() const { return m_Version; }
+
 	private:
+		void MarkDirty();
+
+		uint32_t m_Version = 0;
 		mutable bool m_MatrixDirty;
 		mutable glm::mat4 m_ModelMatrix;
 
@@ -56,6 +63,9 @@ namespace X3
 	struct MeshComponent {
 		LR_GUID guid = LR_GUID::INVALID;
 		std::string sourceName = "";
+		// never moves at runtime - the renderer merges all static meshes into one world space BVH (static batch),
+		// editing the entity afterwards still works but rebuilds the whole batch
+		bool isStatic = false;
 	};
 
 	struct MaterialComponent {
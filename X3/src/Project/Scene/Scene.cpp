@@ -139,6 +139,7 @@ namespace X3
 				<< YAML::BeginMap
 					<< YAML::Key << "SourceName" << YAML::Value << mc.sourceName
 					<< YAML::Key << "MeshGuid"   << YAML::Value << static_cast<uint64_t>(mc.guid)
+					<< YAML::Key << "Static"     << YAML::Value << mc.isStatic
 				<< YAML::EndMap;
 			}
 			
@@ -269,6 +270,7 @@ namespace X3
 					auto mnode = entityNode["MeshComponent"];
 					mc.sourceName = getScalar(mnode["SourceName"], std::string(""), "SourceName");
 					mc.guid       = static_cast<LR_GUID>(getScalar(mnode["MeshGuid"], uint64_t(0), "MeshGuid"));
+					mc.isStatic   = getScalar(mnode["Static"], false, "Static");
 				}
 
 				if (entityNode["MaterialComponent"]) {
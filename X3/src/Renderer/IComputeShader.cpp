@@ -5,13 +5,14 @@
 namespace X3 
 {
 
-	std::shared_ptr<IComputeShader> IComputeShader::Create(const std::string& filepath, const glm::uvec3& workGroupSizes) {
+	std::shared_ptr<IComputeShader> IComputeShader::Create(const std::string& filepath, const glm::uvec3& workGroupSizes,
+														   const std::vector<std::string>& defines) {
 		switch (IRendererAPI::GetAPI()) {
 			case IRendererAPI::API::None: 
 				LOG_ENGINE_CRITICAL("RendererAPI::None - UNSUPPORTED"); 
 				return nullptr;
 			case IRendererAPI::API::OpenGL: 
-				return std::make_shared<OpenGLComputeShader>(filepath, workGroupSizes);
+				return std::make_shared<OpenGLComputeShader>(filepath, workGroupSizes, defines);
 
 		}
 		return nullptr;
@@ -5,14 +5,21 @@
 namespace X3 
 {
 
+	class IShaderStorageBuffer;
+
 	class IComputeShader {
 	public:
-		static std::shared_ptr<IComputeShader> Create(const std::string& filepath, const glm::uvec3& workGroupSizes);
+		/// 'defines' are inserted as "#define <define>" right after the #version line,
+		/// to compile several kernels (e.g. the wavefront stages) from one source file
+		static std::shared_ptr<IComputeShader> Create(const std::string& filepath, const glm::uvec3& workGroupSizes,
+													  const std::vector<std::string>& defines = {});
 
 		virtual ~IComputeShader() {}
 		virtual void Bind() = 0;
 		virtual void Unbind() = 0;
 		virtual void Dispatch() = 0;
+		/// Dispatches the work group counts stored (3 uints) at 'offset' in 'args', e.g. written by a previous dispatch
+		virtual void DispatchIndirect(const IShaderStorageBuffer& args, uint64_t offset) = 0;
 
 		/// SETTERS ///
 		virtual void setWorkGroupSizes(const glm::uvec3 workGroupSizes) = 0;
@@ -5,7 +5,7 @@
 namespace X3
 {
 
-	std::shared_ptr<IShaderStorageBuffer> IShaderStorageBuffer::Create(uint32_t size, uint32_t bindingPoint, BufferUsageType type) {
+	std::shared_ptr<IShaderStorageBuffer> IShaderStorageBuffer::Create(uint64_t size, uint32_t bindingPoint, BufferUsageType type) {
 		switch (IRendererAPI::GetAPI()) {
 			case IRendererAPI::API::None: 
 				LOG_ENGINE_CRITICAL("RendererAPI::None - UNSUPPORTED"); 
@@ -16,4 +16,26 @@ namespace X3
 		return nullptr;
 	}
 
+	std::shared_ptr<IShaderStorageBuffer> IShaderStorageBuffer::CreateAtomicCounter(uint64_t size, uint32_t bindingPoint, BufferUsageType type) {
+		switch (IRendererAPI::GetAPI()) {
+			case IRendererAPI::API::None: 
+				LOG_ENGINE_CRITICAL("RendererAPI::None - UNSUPPORTED"); 
+				return nullptr;
+			case IRendererAPI::API::OpenGL: 
+				return std::make_shared<OpenGLShaderStorageBuffer>(size, bindingPoint, type, true);
+		}
+		return nullptr;
+	}
+
+	uint64_t IShaderStorageBuffer::GetMaxBlockSize() {
+		switch (IRendererAPI::GetAPI()) {
+			case IRendererAPI::API::None:
+				LOG_ENGINE_CRITICAL("RendererAPI::None - UNSUPPORTED");
+				return 0;
+			case IRendererAPI::API::OpenGL:
+				return OpenGLShaderStorageBuffer::GetMaxBlockSize();
+		}
+		return 0;
+	}
+
 }
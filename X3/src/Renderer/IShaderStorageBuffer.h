@@ -18,7 +18,13 @@ namespace X3
 
 	class IShaderStorageBuffer {
 	public:
-		static std::shared_ptr<IShaderStorageBuffer> Create(uint32_t size, uint32_t bindingPoint, BufferUsageType type);
+		static std::shared_ptr<IShaderStorageBuffer> Create(uint64_t size, uint32_t bindingPoint, BufferUsageType type);
+		/// Buffer bound to an atomic counter binding point only ('layout(binding = ...) uniform atomic_uint'),
+		/// counters don't take up one of the program's shader storage blocks
+		static std::shared_ptr<IShaderStorageBuffer> CreateAtomicCounter(uint64_t size, uint32_t bindingPoint, BufferUsageType type);
+
+		/// Largest buffer (in bytes) the device binds to one shader storage block, larger data has to be split
+		static uint64_t GetMaxBlockSize();
 
 		virtual ~IShaderStorageBuffer() = default;
 
@@ -27,9 +33,12 @@ namespace X3
 
 		virtual void SetBindingPoint(uint32_t bindingPoint) = 0;
 
-		virtual void AddData(uint32_t offset, uint32_t dataSize, const void* data) = 0;
+		virtual void AddData(uint64_t offset, uint64_t dataSize, const void* data) = 0;
+
+		/// GPU side copy of 'dataSize' bytes at 'sourceOffset' in 'source' to 'offset' in this buffer (e.g. into a grown buffer)
+		virtual void CopyData(const IShaderStorageBuffer& source, uint64_t sourceOffset, uint64_t offset, uint64_t dataSize) = 0;
 
-		virtual void* ReadData(uint32_t offset, uint32_t dataSize) = 0;
+		virtual void* ReadData(uint64_t offset, uint64_t dataSize) = 0;
 	};
 
 }
\ No newline at end of file
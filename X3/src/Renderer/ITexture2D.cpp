@@ -15,4 +15,15 @@ namespace X3
 		}
 		return nullptr;
 	}
+
+	std::shared_ptr<ITexture2D> ITexture2D::Create(const float* data, const int width, const int height, int textureUnit) {
+		switch (IRendererAPI::GetAPI()) {
+			case IRendererAPI::API::None: 
+				LOG_ENGINE_CRITICAL("in ITexture2D::Create() - RendererAPI::None UNSUPPORTED"); 
+				return nullptr;
+			case IRendererAPI::API::OpenGL: 
+				return std::make_shared<OpenGLTexture2D>(data, width, height, textureUnit);
+		}
+		return nullptr;
+	}
 }
\ No newline at end of file
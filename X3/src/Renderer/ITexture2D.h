@@ -8,6 +8,8 @@ namespace X3
 	class ITexture2D {
 	public:
 		static std::shared_ptr<ITexture2D> Create(const unsigned char* data, const int width, const int height, int textureUnit);
+		// Single channel 32 bit float texture, for lookup tables the shader reads with texelFetch()
+		static std::shared_ptr<ITexture2D> Create(const float* data, const int width, const int height, int textureUnit);
 		virtual ~ITexture2D() {}
 		virtual void ChangeTextureUnit(int textureUnit) = 0;
 		virtual int GetID() const = 0;
@@ -15,6 +15,12 @@ namespace X3
         glm::uvec2 resolution{ 400, 300 };
         int raysPerPixel = 1;
         int bouncesPerRay = 5;
+        int bvhWidth = 2; // 2 = binary BVH, 4 or 8 = traverse the BVHs collapsed to that many children per node
+        bool quantizedBVH = false; // wide BVHs only: child bounds stored as 8 bit offsets (80 instead of 128 byte packets)
+        bool wavefront = false; // separate generation, extension, shading & accumulation passes over compacted ray queues instead of the megakernel
+        bool persistentThreads = false; // megakernel only: a fixed number of work groups pulls pixels from an atomic counter, terminated paths are replaced right away
+        bool nextEventEstimation = true; // sample the emissive triangles with shadow rays at every bounce, combined with the BSDF samples by MIS
+        bool anyHitShadowRays = true; // shadow rays stop at their first hit instead of running the closest hit traversal (kept to compare)
         bool accumulate = false;
         bool vSync = true;
         
@@ -26,6 +32,12 @@ namespace X3
 			rsNode["resolution"] = YAML::Load("[" + std::to_string(resolution.x) + ", " + std::to_string(resolution.y) + "]");
 			rsNode["raysPerPixel"] = raysPerPixel;
 			rsNode["bouncesPerRay"] = bouncesPerRay;
+			rsNode["bvhWidth"] = bvhWidth;
+			rsNode["quantizedBVH"] = quantizedBVH;
+			rsNode["wavefront"] = wavefront;
+			rsNode["persistentThreads"] = persistentThreads;
+			rsNode["nextEventEstimation"] = nextEventEstimation;
+			rsNode["anyHitShadowRays"] = anyHitShadowRays;
 			rsNode["accumulate"] = accumulate;
 			rsNode["vSync"] = vSync;
         }
@@ -43,6 +55,12 @@ namespace X3
 				}
 				if (auto n = rsNode["raysPerPixel"])  raysPerPixel = n.as<uint32_t>();
 				if (auto n = rsNode["bouncesPerRay"]) bouncesPerRay = n.as<uint32_t>();
+				if (auto n = rsNode["bvhWidth"])      bvhWidth = n.as<uint32_t>();
+				if (auto n = rsNode["quantizedBVH"])  quantizedBVH = n.as<bool>();
+				if (auto n = rsNode["wavefront"])     wavefront = n.as<bool>();
+				if (auto n = rsNode["persistentThreads"]) persistentThreads = n.as<bool>();
+				if (auto n = rsNode["nextEventEstimation"]) nextEventEstimation = n.as<bool>();
+				if (auto n = rsNode["anyHitShadowRays"]) anyHitShadowRays = n.as<bool>();
 				if (auto n = rsNode["accumulate"])    accumulate = n.as<bool>();
 				if (auto n = rsNode["vSync"])         vSync = n.as<bool>();
 
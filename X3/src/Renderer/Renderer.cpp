@@ -12,10 +12,124 @@
 namespace X3 
 {
 
+	// Writes elements [first, first + count) of 'data' to the shards, split at the shard boundaries (offsets in bytes can
+	// pass 4 GiB). A shard the range ends past grows by half its capacity at least, its contents copied over on the GPU,
+	// so a run of appends uploads each element once. Returns false if the range needs more shards than the SSBO has.
+	template <typename T>
+	static bool UploadShardedRange(ShardedSSBO& ssbo, const T* data, uint64_t first, uint64_t count) {
+		if (count == 0) {
+			return true;
+		}
+		const uint64_t lastShard = (first + count - 1) / ssbo.ShardElements;
+		if (lastShard >= ssbo.ShardCount) {
+			LOG_ENGINE_CRITICAL("UploadShardedRange: {0} MiB exceed {1} SSBOs of {2} MiB, not uploaded",
+				sizeof(T) * (first + count) >> 20, ssbo.ShardCount, sizeof(T) * ssbo.ShardElements >> 20);
+			return false;
+		}
+		for (uint64_t shard = first / ssbo.ShardElements; shard <= lastShard; shard++) {
+			const uint64_t required = (shard < lastShard) ? ssbo.ShardElements : first + count - shard * ssbo.ShardElements;
+			if (ssbo.Shards[shard] && ssbo.Capacities[shard] >= required) {
+				continue;
+			}
+			const uint64_t capacity = std::min<uint64_t>(std::max(required, ssbo.Capacities[shard] + ssbo.Capacities[shard] / 2), ssbo.ShardElements);
+			auto grown = IShaderStorageBuffer::Create(sizeof(T) * capacity, ssbo.BindingPoints[shard], BufferUsageType::STATIC_DRAW);
+			if (ssbo.Shards[shard] && ssbo.Capacities[shard] != 0) {
+				grown->CopyData(*ssbo.Shards[shard], 0, 0, sizeof(T) * ssbo.Capacities[shard]);
+			}
+			ssbo.Shards[shard] = grown;
+			ssbo.Capacities[shard] = capacity;
+		}
+
+		while (count != 0) {
+			const uint64_t shard = first / ssbo.ShardElements;
+			const uint64_t local = first % ssbo.ShardElements;
+			const uint64_t inShard = std::min<uint64_t>(count, ssbo.ShardElements - local);
+			ssbo.Shards[shard]->Bind();
+			ssbo.Shards[shard]->AddData(sizeof(T) * local, sizeof(T) * inShard, data + first);
+			ssbo.Shards[shard]->Unbind();
+			first += inShard;
+			count -= inShard;
+		}
+		return true;
+	}
+
+	// Drops the shards and uploads 'count' elements into new ones of exactly the size needed
+	template <typename T>
+	static bool UploadSharded(ShardedSSBO& ssbo, const T* data, uint64_t count) {
+		ssbo.Shards = {};
+		ssbo.Capacities = {};
+		ssbo.ShardElements = static_cast<uint32_t>(std::clamp<uint64_t>(IShaderStorageBuffer::GetMaxBlockSize() / sizeof(T), 1, UINT32_MAX));
+		if (count == 0) { // still bound, the shader never reads it
+			ssbo.Shards[0] = IShaderStorageBuffer::Create(0, ssbo.BindingPoints[0], BufferUsageType::STATIC_DRAW);
+			return true;
+		}
+		if (!UploadShardedRange(ssbo, data, 0, count)) {
+			ssbo.Shards = {};
+			ssbo.Capacities = {};
+			return false;
+		}
+		return true;
+	}
+
+	// Uploads an AssetPool buffer once its version changed - only the ranges recorded since 'prevVersion' (appended ones
+	// grow the shards) if the GPU copy is recent enough for them (AssetPool::GetRangeBaseVersion()), else the whole buffer
+	template <typename T>
+	static void UploadAssetBuffer(ShardedSSBO& ssbo, const std::vector<T>& buffer,
+								  const AssetPool* assetPool, AssetPool::AssetType type, uint32_t& prevVersion) {
+		const uint32_t currVersion = assetPool->GetUpdateVersion(type);
+		if (prevVersion == currVersion) {
+			return;
+		}
+
+		bool uploaded = true;
+		if (ssbo.Shards[0] && prevVersion >= assetPool->GetRangeBaseVersion(type)) {
+			for (const AssetPool::DirtyRange& range : assetPool->GetDirtyRanges(type)) {
+				if (range.version > prevVersion && !UploadShardedRange(ssbo, buffer.data(), range.first, range.count)) {
+					ssbo.Shards = {}; // the next try starts over with a full upload
+					ssbo.Capacities = {};
+					uploaded = false;
+					break;
+				}
+			}
+		}
+		else {
+			uploaded = UploadSharded(ssbo, buffer.data(), buffer.size());
+		}
+		if (uploaded) { // else retried next frame
+			prevVersion = currVersion;
+		}
+	}
+
+	// bounds of the mesh's root node moved into world space (Arvo's method)
+	static BVHAccel::Aabb TransformAabb(const BVHAccel::Node& root, const glm::mat4& transform) {
+		const glm::vec3 center = (root.min + root.max) * 0.5f;
+		const glm::vec3 extent = (root.max - root.min) * 0.5f;
+		const glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+		const glm::mat3 absLinear = glm::mat3(glm::abs(transform[0]), glm::abs(transform[1]), glm::abs(transform[2]));
+		const glm::vec3 worldExtent = absLinear * extent;
+		return BVHAccel::Aabb(worldCenter - worldExtent, worldCenter + worldExtent);
+	}
+
+	// NodeBuffer ranges refit in place (AssetPool::MarkRangeUpdated) after 'sinceVersion'
+	static std::vector<AssetPool::DirtyRange> RefitNodeRanges(const AssetPool* assetPool, uint32_t sinceVersion) {
+		std::vector<AssetPool::DirtyRange> refitRanges;
+		for (const AssetPool::DirtyRange& range : assetPool->GetDirtyRanges(AssetPool::AssetType::NodeBuffer)) {
+			if (range.version > sinceVersion) {
+				refitRanges.push_back(range);
+			}
+		}
+		return refitRanges;
+	}
+
+	static bool IsInRanges(const std::vector<AssetPool::DirtyRange>& ranges, uint32_t idx) {
+		return std::any_of(ranges.begin(), ranges.end(), [idx](const AssetPool::DirtyRange& range) {
+			return idx >= range.first && idx < range.first + range.count; });
+	}
+
 	void Renderer::Init() {
 		// fixed size from start
 		m_CameraUBO = IUniformBuffer::Create(80, 0, BufferUsageType::DYNAMIC_DRAW);
-		m_SettingsUBO = IUniformBuffer::Create(48, 1, BufferUsageType::DYNAMIC_DRAW);
+		m_SettingsUBO = IUniformBuffer::Create(80, 1, BufferUsageType::DYNAMIC_DRAW);
 
 		// work group sizes set in Draw() before shader->dispatch() 
 		m_Shader = IComputeShader::Create(m_ComputeShaderPath.string(), glm::uvec3(1)); 
@@ -26,18 +140,207 @@ namespace X3
 		m_Shader->Bind();
 	}
 
+	void Renderer::UpdateStaticBatch(const Scene* scene, AssetManager& assetManager) {
+		if (scene == nullptr) {
+			return;
+		}
+
+		struct StaticEntity {
+			uint32_t id;
+			uint32_t transformVersion;
+			LR_GUID meshGuid;
+		};
+		std::vector<StaticEntity> staticEntities;
+		const AssetPool* assetPool = assetManager.GetAssetPool().get();
+		auto MeshRange = [assetPool](const LR_GUID& meshGuid) {
+			std::shared_ptr<MeshMetadata> metadata = assetPool->find<MeshMetadata>(meshGuid);
+			return metadata ? Cache::StaticBatchMeshRange{ metadata->firstTriIdx, metadata->TriCount, metadata->firstVertexIdx, metadata->nodeCount }
+							: Cache::StaticBatchMeshRange{};
+		};
+		auto renderableView = scene->GetRegistry()->view<TransformComponent, MeshComponent>();
+		for (auto entity : renderableView) {
+			const MeshComponent& meshComponent = renderableView.get<MeshComponent>(entity);
+			if (meshComponent.isStatic) {
+				staticEntities.push_back({ static_cast<uint32_t>(entity), renderableView.get<TransformComponent>(entity).GetVersion(), meshComponent.guid });
+			}
+		}
+		std::sort(staticEntities.begin(), staticEntities.end(), [](const StaticEntity& a, const StaticEntity& b) { return a.id < b.id; });
+
+		// transform versions are unique across all transforms, so any edit shows up here. Only the batched meshes' own
+		// metadata is compared, other imports, removals & compaction steps leave the batch alone
+		bool changed = staticEntities.size() != m_Cache.StaticBatchEntityIds.size();
+		for (uint32_t i = 0; !changed && i < staticEntities.size(); i++) {
+			changed = staticEntities[i].id != m_Cache.StaticBatchEntityIds[i] ||
+					  staticEntities[i].transformVersion != m_Cache.StaticBatchTransformVersions[i] ||
+					  staticEntities[i].meshGuid != m_Cache.StaticBatchMeshGuids[i] ||
+					  MeshRange(staticEntities[i].meshGuid) != m_Cache.StaticBatchMeshRanges[i];
+		}
+		if (!changed) {
+			return;
+		}
+		auto t = m_Profiler->timer("Renderer::UpdateStaticBatch()");
+
+		std::vector<StaticBatchInstance> instances;
+		instances.reserve(staticEntities.size());
+		m_Cache.StaticBatchEntityIds.clear();
+		m_Cache.StaticBatchTransformVersions.clear();
+		m_Cache.StaticBatchMeshGuids.clear();
+		m_Cache.StaticBatchMeshRanges.clear();
+		for (uint32_t i = 0; i < staticEntities.size(); i++) {
+			const StaticEntity& staticEntity = staticEntities[i];
+			const glm::mat4 transform = renderableView.get<TransformComponent>(static_cast<entt::entity>(staticEntity.id)).GetMatrix();
+			instances.push_back({ staticEntity.meshGuid, transform, i });
+			m_Cache.StaticBatchEntityIds.push_back(staticEntity.id);
+			m_Cache.StaticBatchTransformVersions.push_back(staticEntity.transformVersion);
+			m_Cache.StaticBatchMeshGuids.push_back(staticEntity.meshGuid);
+			m_Cache.StaticBatchMeshRanges.push_back(MeshRange(staticEntity.meshGuid));
+		}
+		assetManager.BuildStaticBatch(m_Cache.StaticBatchGuid, instances);
+	}
+
 	std::shared_ptr<IImage2D> Renderer::Render(const Scene* scene, const AssetPool* assetPool) {
 		auto t = m_Profiler->timer("Renderer::Render()");
 
+		UpdateWideBVH(assetPool);
 		const auto pScene = Parse(scene, assetPool);
 		if (!pScene) { // Most likely scene missing camera
 			return nullptr;
 		}
+		UpdateInstanceTransforms(pScene, assetPool);
+		UpdateTLAS(pScene, assetPool);
+		UpdateLightList(pScene, assetPool);
 		SetupGPUResources(pScene, scene, assetPool);
 		Draw();
 		return m_Frame;
 	}
 
+	void Renderer::UpdateWideBVH(const AssetPool* assetPool) {
+		const uint32_t width = static_cast<uint32_t>(m_RenderSettings.bvhWidth);
+		if (width != 4 && width != 8) {
+			return; // binary traversal reads the NodeBuffer directly
+		}
+
+		const bool quantized = m_RenderSettings.quantizedBVH;
+		const uint32_t nodeBufferVersion = assetPool->GetUpdateVersion(AssetPool::AssetType::NodeBuffer);
+		if (width == m_Cache.WideBVHWidth && quantized == m_Cache.WideBVHQuantized && nodeBufferVersion == m_Cache.WideBVHNodeBufferVersion) {
+			return;
+		}
+		auto t = m_Profiler->timer("Renderer::UpdateWideBVH()");
+
+		// encodes m_WidePackets[first, first + count) if needed, the quantized packets keep the same indices
+		auto EncodePackets = [&](uint32_t first, uint32_t count) {
+			if (quantized) {
+				m_QuantizedPackets.resize(m_WidePackets.size());
+				for (uint32_t i = first; i < first + count; i++) {
+					m_QuantizedPackets[i] = BVHAccel::Quantize(m_WidePackets[i]);
+				}
+			}
+		};
+
+		// uploads m_WidePackets[first, first + count) (or their quantized version), growing the SSBO for appended ones
+		auto UploadPackets = [&](uint32_t first, uint32_t count) {
+			return quantized ? UploadShardedRange(m_WideNodeSSBO, m_QuantizedPackets.data(), first, count)
+							 : UploadShardedRange(m_WideNodeSSBO, m_WidePackets.data(), first, count);
+		};
+
+		// Wide Nodes - BINDING POINT 8, Quantized Wide Nodes - BINDING POINT 9 (only the one in use)
+		const bool fullUpdate = !m_WideNodeSSBO.Shards[0] || width != m_Cache.WideBVHWidth || quantized != m_Cache.WideBVHQuantized ||
+			m_Cache.WideBVHNodeBufferVersion < assetPool->GetRangeBaseVersion(AssetPool::AssetType::NodeBuffer) ||
+			m_Cache.WideBVHUnusedPackets > m_WidePackets.size() / 2;
+		if (fullUpdate) {
+			m_WidePackets.clear();
+			m_Cache.WideBVHRanges.clear();
+			m_Cache.WideBVHUnusedPackets = 0;
+			for (const auto& [guid, metadataPair] : assetPool->Metadata) {
+				auto metadata = std::dynamic_pointer_cast<MeshMetadata>(metadataPair.first);
+				if (!metadata || metadata->nodeCount == 0) {
+					continue;
+				}
+				uint32_t firstPacketIdx, packetCount;
+				BVHAccel::Collapse(assetPool->NodeBuffer, metadata->firstNodeIdx, metadata->nodeCount, width, m_WidePackets, firstPacketIdx, packetCount);
+				m_Cache.WideBVHRanges[metadata->firstNodeIdx] = { metadata->nodeCount, firstPacketIdx, packetCount };
+			}
+			EncodePackets(0, static_cast<uint32_t>(m_WidePackets.size()));
+
+			m_WideNodeSSBO.BindingPoints[0] = quantized ? 9 : 8;
+			if (quantized) {
+				UploadSharded(m_WideNodeSSBO, m_QuantizedPackets.data(), m_QuantizedPackets.size());
+			} else {
+				UploadSharded(m_WideNodeSSBO, m_WidePackets.data(), m_WidePackets.size());
+			}
+		}
+		else {
+			// compaction slides whole BVHs down, their packets stay valid under the new first node. The destination
+			// was free, so whatever is still keyed there belonged to a removed mesh
+			for (const AssetPool::RangeMove& move : assetPool->GetMovedRanges(AssetPool::AssetType::NodeBuffer)) {
+				if (move.version <= m_Cache.WideBVHNodeBufferVersion) {
+					continue;
+				}
+				auto moved = m_Cache.WideBVHRanges.extract(move.from);
+				std::erase_if(m_Cache.WideBVHRanges, [&move](const auto& entry) {
+					return entry.first >= move.to && entry.first < move.to + move.count; });
+				if (moved) {
+					moved.key() = move.to;
+					m_Cache.WideBVHRanges.insert(std::move(moved));
+				}
+			}
+
+			// BVHs of removed meshes (or replaced by a rebuild somewhere else) leave their packets unused
+			std::unordered_map<uint32_t, uint32_t> liveNodeCounts; // first node -> node count
+			for (const auto& [guid, metadataPair] : assetPool->Metadata) {
+				auto metadata = std::dynamic_pointer_cast<MeshMetadata>(metadataPair.first);
+				if (metadata && metadata->nodeCount != 0) {
+					liveNodeCounts[metadata->firstNodeIdx] = metadata->nodeCount;
+				}
+			}
+			std::erase_if(m_Cache.WideBVHRanges, [&](const auto& entry) {
+				auto live = liveNodeCounts.find(entry.first);
+				const bool unused = live == liveNodeCounts.end() || live->second != entry.second.NodeCount;
+				m_Cache.WideBVHUnusedPackets += unused ? entry.second.PacketCount : 0;
+				return unused;
+			});
+
+			// Refits keep the binary topology and with it the collapsed layout, they are re-collapsed in place. New BVHs
+			// (imports, rebuilds into a reused range) are collapsed and appended, only their packets are uploaded
+			const auto dirtyRanges = RefitNodeRanges(assetPool, m_Cache.WideBVHNodeBufferVersion);
+			const uint32_t firstAppendedPacket = static_cast<uint32_t>(m_WidePackets.size());
+			std::vector<BVHAccel::WidePacket> packets;
+			bool uploaded = true;
+			for (const auto& [firstNodeIdx, nodeCount] : liveNodeCounts) {
+				auto wideRange = m_Cache.WideBVHRanges.find(firstNodeIdx);
+				const bool collapsed = wideRange != m_Cache.WideBVHRanges.end();
+				if (collapsed && !IsInRanges(dirtyRanges, firstNodeIdx)) {
+					continue;
+				}
+				packets.clear();
+				uint32_t firstPacketIdx, packetCount;
+				BVHAccel::Collapse(assetPool->NodeBuffer, firstNodeIdx, nodeCount, width, packets, firstPacketIdx, packetCount);
+				if (collapsed && packetCount == wideRange->second.PacketCount) {
+					std::copy(packets.begin(), packets.end(), m_WidePackets.begin() + wideRange->second.FirstPacketIdx);
+					EncodePackets(wideRange->second.FirstPacketIdx, packetCount);
+					uploaded &= UploadPackets(wideRange->second.FirstPacketIdx, packetCount);
+					continue;
+				}
+				if (collapsed) {
+					m_Cache.WideBVHUnusedPackets += wideRange->second.PacketCount;
+				}
+				m_Cache.WideBVHRanges[firstNodeIdx] = { nodeCount, static_cast<uint32_t>(m_WidePackets.size()), packetCount };
+				m_WidePackets.insert(m_WidePackets.end(), packets.begin(), packets.end());
+			}
+			const uint32_t appendedPackets = static_cast<uint32_t>(m_WidePackets.size()) - firstAppendedPacket;
+			EncodePackets(firstAppendedPacket, appendedPackets);
+			uploaded &= UploadPackets(firstAppendedPacket, appendedPackets);
+			if (!uploaded) {
+				m_WideNodeSSBO.Shards = {}; // the next update starts over with a full upload
+				m_WideNodeSSBO.Capacities = {};
+			}
+		}
+
+		m_Cache.WideBVHWidth = width;
+		m_Cache.WideBVHQuantized = quantized;
+		m_Cache.WideBVHNodeBufferVersion = nodeBufferVersion;
+	}
+
 	std::shared_ptr<const Renderer::ParsedScene> Renderer::Parse(const Scene* scene, const AssetPool* assetPool) const {
 		if (scene == nullptr) {
 			return nullptr;
@@ -71,38 +374,311 @@ namespace X3
 		pScene->MeshEntityLookupTable.reserve(renderableView.size_hint());
 		pScene->TransformBuffer.reserve(renderableView.size_hint());
 		pScene->MaterialBuffer.reserve(renderableView.size_hint());
+		pScene->EntityIds.reserve(renderableView.size_hint());
+		pScene->TransformVersions.reserve(renderableView.size_hint());
+
+		// material not guaranteed
+		auto EmplaceMaterial = [&](EntityHandle& e) {
+			if (e.HasComponent<MaterialComponent>()) {
+				MaterialComponent& materialComponent = e.GetComponent<MaterialComponent>();
+				pScene->MaterialBuffer.emplace_back(materialComponent.emission, materialComponent.color);
+			} else {
+				pScene->MaterialBuffer.emplace_back(); // default constructed material
+			}
+		};
+
+		// STATIC BATCH - a single entity already in world space, its materials are laid out in slot order
+		const auto& batchedEntityIds = m_Cache.StaticBatchEntityIds;
+		std::shared_ptr<MeshMetadata> batchMetadata = assetPool->find<MeshMetadata>(m_Cache.StaticBatchGuid);
+		if (batchMetadata && batchMetadata->nodeCount != 0) {
+			const uint32_t firstMaterialIdx = static_cast<uint32_t>(pScene->MaterialBuffer.size());
+			for (uint32_t entityId : batchedEntityIds) {
+				const entt::entity entity = static_cast<entt::entity>(entityId);
+				if (scene->GetRegistry()->valid(entity)) {
+					EntityHandle e(entity, scene->GetRegistry());
+					EmplaceMaterial(e);
+				} else {
+					pScene->MaterialBuffer.emplace_back(); // deleted since the batch was baked, gone with the next one
+				}
+			}
+			pScene->TransformBuffer.emplace_back(1.0f);
+			pScene->EntityIds.emplace_back(STATIC_BATCH_ENTITY_ID);
+			pScene->TransformVersions.emplace_back(0); // re-bakes mark the batch's NodeBuffer range updated (refit) or move it (rebuild)
+
+			auto wideRange = m_Cache.WideBVHRanges.find(batchMetadata->firstNodeIdx);
+			pScene->MeshEntityLookupTable.emplace_back (
+				batchMetadata->firstTriIdx,
+				batchMetadata->TriCount,
+				batchMetadata->firstNodeIdx,
+				batchMetadata->nodeCount,
+				MeshEntityHandle::LEAF_ORDERED,
+				batchMetadata->indexCount,
+				pScene->TransformBuffer.size() - 1,
+				firstMaterialIdx,
+				(wideRange != m_Cache.WideBVHRanges.end()) ? wideRange->second.FirstPacketIdx : 0,
+				MeshEntityHandle::STATIC_BATCH
+			);
+		} else {
+			batchMetadata = nullptr;
+		}
 
 		for (auto entity : renderableView) {
 			EntityHandle e(entity, scene->GetRegistry());
+			if (batchMetadata && e.GetComponent<MeshComponent>().isStatic &&
+				std::binary_search(batchedEntityIds.begin(), batchedEntityIds.end(), static_cast<uint32_t>(entity))) {
+				continue;
+			}
 			LR_GUID& guid = e.GetComponent<MeshComponent>().guid;
 			std::shared_ptr<MeshMetadata> metadata = assetPool->find<MeshMetadata>(guid);
-			if (!metadata) {
+			if (!metadata || metadata->nodeCount == 0) {
 				continue;
 			}
 			
 			// transform guaranteed by the view
-			pScene->TransformBuffer.emplace_back(e.GetComponent<TransformComponent>().GetMatrix());
+			const TransformComponent& transformComponent = e.GetComponent<TransformComponent>();
+			pScene->TransformBuffer.emplace_back(transformComponent.GetMatrix());
+			pScene->EntityIds.emplace_back(static_cast<uint32_t>(entity));
+			pScene->TransformVersions.emplace_back(transformComponent.GetVersion());
 
-			// material not guaranteed
-			if (e.HasComponent<MaterialComponent>()) {
-				MaterialComponent& materialComponent = e.GetComponent<MaterialComponent>();
-				pScene->MaterialBuffer.emplace_back(materialComponent.emission, materialComponent.color);
-			} else {
-				pScene->MaterialBuffer.emplace_back(); // default constructed material
-			}
+			EmplaceMaterial(e);
 
+			auto wideRange = m_Cache.WideBVHRanges.find(metadata->firstNodeIdx);
 			pScene->MeshEntityLookupTable.emplace_back (
 				metadata->firstTriIdx,
 				metadata->TriCount,
 				metadata->firstNodeIdx,
 				metadata->nodeCount,
+				metadata->leafOrdered ? MeshEntityHandle::LEAF_ORDERED : metadata->firstIndexIdx,
+				metadata->indexCount,
 				pScene->TransformBuffer.size() - 1,
-				pScene->MaterialBuffer.size() - 1
+				pScene->MaterialBuffer.size() - 1,
+				(wideRange != m_Cache.WideBVHRanges.end()) ? wideRange->second.FirstPacketIdx : 0,
+				metadata->indexedVertices ? metadata->firstVertexIdx :
+					metadata->precomputedTriangles ? MeshEntityHandle::PRECOMPUTED_TRIANGLES : MeshEntityHandle::NOT_INDEXED
 			);
 		}
 		return pScene;
 	}
 
+	void Renderer::UpdateInstanceTransforms(std::shared_ptr<const ParsedScene> pScene, const AssetPool* assetPool) {
+		auto t = m_Profiler->timer("Renderer::UpdateInstanceTransforms()");
+
+		const auto& lookupTable = pScene->MeshEntityLookupTable;
+		auto ComputeInstance = [&](uint32_t entityIdx) {
+			const MeshEntityHandle& handle = lookupTable[entityIdx];
+			InstanceTransform& instance = m_InstanceTransforms[handle.TransformIdx];
+			instance.Model = pScene->TransformBuffer[handle.TransformIdx];
+			instance.InverseModel = glm::inverse(instance.Model);
+			instance.NormalMatrix = glm::mat3x4(glm::transpose(glm::mat3(instance.InverseModel)));
+			const BVHAccel::Aabb worldBounds = TransformAabb(assetPool->NodeBuffer[handle.FirstNodeIdx], instance.Model);
+			instance.WorldMin = glm::vec4(worldBounds.boxMin, 0.0f);
+			instance.WorldMax = glm::vec4(worldBounds.boxMax, 0.0f);
+		};
+
+		// Instance Transforms - BINDING POINT 1
+		const uint32_t nodeBufferVersion = assetPool->GetUpdateVersion(AssetPool::AssetType::NodeBuffer);
+		const bool fullUpdate = !m_TransformSSBO || m_Cache.InstanceEntityIds != pScene->EntityIds ||
+			m_Cache.InstanceNodeBufferVersion < assetPool->GetRangeBaseVersion(AssetPool::AssetType::NodeBuffer);
+		if (fullUpdate) {
+			m_InstanceTransforms.resize(pScene->TransformBuffer.size());
+			m_Cache.InstanceFirstNodeIdx.resize(lookupTable.size());
+			for (uint32_t i = 0; i < lookupTable.size(); i++) {
+				ComputeInstance(i);
+				m_Cache.InstanceFirstNodeIdx[i] = lookupTable[i].FirstNodeIdx;
+			}
+
+			uint64_t sizeBytes = sizeof(InstanceTransform) * m_InstanceTransforms.size();
+			m_TransformSSBO = IShaderStorageBuffer::Create(sizeBytes, 1, BufferUsageType::DYNAMIC_DRAW);
+			m_TransformSSBO->Bind();
+			m_TransformSSBO->AddData(0, sizeBytes, m_InstanceTransforms.data());
+			m_TransformSSBO->Unbind();
+			m_Cache.InstanceEntityIds = pScene->EntityIds;
+			m_Cache.InstanceTransformVersions = pScene->TransformVersions;
+		}
+		else {
+			// same entities in the same order, only moved ones & refit BLASes (new root bounds) are recomputed
+			const std::vector<AssetPool::DirtyRange> refitNodeRanges = RefitNodeRanges(assetPool, m_Cache.InstanceNodeBufferVersion);
+			m_TransformSSBO->Bind();
+			for (uint32_t i = 0; i < lookupTable.size(); i++) {
+				const MeshEntityHandle& handle = lookupTable[i];
+				if (pScene->TransformVersions[i] == m_Cache.InstanceTransformVersions[i] && handle.FirstNodeIdx == m_Cache.InstanceFirstNodeIdx[i] &&
+					!IsInRanges(refitNodeRanges, handle.FirstNodeIdx)) {
+					continue;
+				}
+				ComputeInstance(i);
+				m_Cache.InstanceTransformVersions[i] = pScene->TransformVersions[i];
+				m_Cache.InstanceFirstNodeIdx[i] = handle.FirstNodeIdx;
+				m_TransformSSBO->AddData(sizeof(InstanceTransform) * handle.TransformIdx, sizeof(InstanceTransform), &m_InstanceTransforms[handle.TransformIdx]);
+			}
+			m_TransformSSBO->Unbind();
+		}
+		m_Cache.InstanceNodeBufferVersion = nodeBufferVersion;
+	}
+
+	void Renderer::UpdateTLAS(std::shared_ptr<const ParsedScene> pScene, const AssetPool* assetPool) {
+		auto t = m_Profiler->timer("Renderer::UpdateTLAS()");
+
+		// world bounds are kept up to date by UpdateInstanceTransforms()
+		const auto& lookupTable = pScene->MeshEntityLookupTable;
+		auto EntityBounds = [&](uint32_t entityIdx) {
+			const InstanceTransform& instance = m_InstanceTransforms[lookupTable[entityIdx].TransformIdx];
+			return BVHAccel::Aabb(glm::vec3(instance.WorldMin), glm::vec3(instance.WorldMax));
+		};
+
+		// different entities (or order) and rebuilt BLASes invalidate the whole tree
+		const uint32_t nodeBufferVersion = assetPool->GetUpdateVersion(AssetPool::AssetType::NodeBuffer);
+		bool rebuild = (m_Cache.TLASEntityIds != pScene->EntityIds) ||
+					   (m_Cache.TLASNodeBufferVersion < assetPool->GetRangeBaseVersion(AssetPool::AssetType::NodeBuffer));
+
+		// refit BLASes (deforming meshes) only move the entities using them
+		const std::vector<AssetPool::DirtyRange> refitNodeRanges = RefitNodeRanges(assetPool, m_Cache.TLASNodeBufferVersion);
+
+		if (!rebuild) {
+			std::vector<uint32_t> movedEntities;
+			std::vector<BVHAccel::Aabb> movedBounds;
+			for (uint32_t i = 0; i < lookupTable.size(); i++) {
+				if (lookupTable[i].FirstNodeIdx != m_Cache.TLASFirstNodeIdx[i]) {
+					rebuild = true; // mesh swapped
+					break;
+				}
+				if (pScene->TransformVersions[i] != m_Cache.TLASTransformVersions[i] || IsInRanges(refitNodeRanges, lookupTable[i].FirstNodeIdx)) {
+					movedEntities.push_back(i);
+					movedBounds.push_back(EntityBounds(i));
+					m_Cache.TLASTransformVersions[i] = pScene->TransformVersions[i];
+				}
+			}
+
+			if (!rebuild && !movedEntities.empty()) {
+				m_TLAS.Refit(movedEntities, movedBounds);
+				rebuild = m_TLAS.NeedsRebuild();
+			}
+			m_Cache.TLASNodeBufferVersion = nodeBufferVersion;
+		}
+
+		if (rebuild) {
+			std::vector<BVHAccel::Aabb> entityBounds(lookupTable.size());
+			m_Cache.TLASFirstNodeIdx.resize(lookupTable.size());
+			for (uint32_t i = 0; i < lookupTable.size(); i++) {
+				entityBounds[i] = EntityBounds(i);
+				m_Cache.TLASFirstNodeIdx[i] = lookupTable[i].FirstNodeIdx;
+			}
+			m_TLAS.Build(entityBounds);
+
+			m_Cache.TLASEntityIds = pScene->EntityIds;
+			m_Cache.TLASTransformVersions = pScene->TransformVersions;
+			m_Cache.TLASNodeBufferVersion = nodeBufferVersion;
+		}
+	}
+
+	static float Luminance(const glm::vec3& color) {
+		return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f)); // same weights as Luminance() in PathTracing.comp
+	}
+
+	// Luminance-weighted 2D CDF of an equirectangular skybox for importance sampling it in PathTracing.comp, (width + 1) x height:
+	// texel (x, y) with x < width is row y's conditional CDF up to & including column x, column 'width' the marginal CDF of the
+	// rows. Texels are weighted by their luminance times the cosine of their row's latitude (the solid angle they cover).
+	// Returns the summed weight, 0 for a black sky
+	static double BuildEnvironmentCdf(const unsigned char* data, int width, int height, int channels, std::vector<float>& cdf) {
+		const size_t cdfWidth = static_cast<size_t>(width) + 1;
+		cdf.assign(cdfWidth * height, 0.0f);
+		double totalWeight = 0.0;
+		for (int y = 0; y < height; y++) {
+			const float cosLatitude = std::cos(((y + 0.5f) / height - 0.5f) * glm::pi<float>()); // v = 0 is the south pole
+			float* row = &cdf[y * cdfWidth];
+			double rowWeight = 0.0;
+			for (int x = 0; x < width; x++) {
+				const unsigned char* texel = data + (static_cast<size_t>(y) * width + x) * channels;
+				const glm::vec3 color = (channels >= 3) ? glm::vec3(texel[0], texel[1], texel[2]) : glm::vec3(texel[0]);
+				rowWeight += Luminance(color / 255.0f) * cosLatitude; // as the shader reads the normalized texture
+				row[x] = static_cast<float>(rowWeight);
+			}
+			for (int x = 0; x < width; x++) {
+				row[x] = (rowWeight > 0.0) ? static_cast<float>(row[x] / rowWeight) : (x + 1.0f) / width; // black rows are never picked
+			}
+			row[width - 1] = 1.0f;
+			totalWeight += rowWeight;
+			row[width] = static_cast<float>(totalWeight);
+		}
+		if (totalWeight <= 0.0) {
+			return 0.0;
+		}
+		for (int y = 0; y < height; y++) {
+			cdf[y * cdfWidth + width] = static_cast<float>(cdf[y * cdfWidth + width] / totalWeight);
+		}
+		cdf[(height - 1) * cdfWidth + width] = 1.0f;
+		return totalWeight;
+	}
+
+	void Renderer::UpdateLightList(std::shared_ptr<const ParsedScene> pScene, const AssetPool* assetPool) {
+		auto t = m_Profiler->timer("Renderer::UpdateLightList()");
+
+		const std::array<uint32_t, 4> geometryVersions = {
+			assetPool->GetUpdateVersion(AssetPool::AssetType::MeshBuffer),
+			assetPool->GetUpdateVersion(AssetPool::AssetType::VertexBuffer),
+			assetPool->GetUpdateVersion(AssetPool::AssetType::FaceBuffer),
+			assetPool->GetUpdateVersion(AssetPool::AssetType::Metadata)
+		};
+		auto SameMaterial = [](const Material& a, const Material& b) { return a.emission == b.emission && a.color == b.color; };
+		if (m_Cache.LightListBuilt && m_Cache.LightEntityIds == pScene->EntityIds && m_Cache.LightTransformVersions == pScene->TransformVersions &&
+			m_Cache.LightGeometryVersions == geometryVersions &&
+			std::equal(m_Cache.LightMaterials.begin(), m_Cache.LightMaterials.end(), pScene->MaterialBuffer.begin(), pScene->MaterialBuffer.end(), SameMaterial)) {
+			return;
+		}
+		m_Cache.LightEntityIds = pScene->EntityIds;
+		m_Cache.LightTransformVersions = pScene->TransformVersions;
+		m_Cache.LightMaterials = pScene->MaterialBuffer;
+		m_Cache.LightGeometryVersions = geometryVersions;
+		m_Cache.LightListBuilt = true;
+		m_Cache.LightsUploaded = false;
+
+		// emitters are tinted by their own color, as where PathTracing.comp picks up the light of a hit
+		auto EmittedRadiance = [](const Material& material) {
+			return (material.emission.w > 0.0f) ? glm::vec3(material.emission) * material.emission.w * glm::vec3(material.color) : glm::vec3(0.0f);
+		};
+
+		m_EmissiveTriangles.clear();
+		float totalPower = 0.0f;
+		for (const MeshEntityHandle& handle : pScene->MeshEntityLookupTable) {
+			const bool materialPerTriangle = handle.FirstVertexIdx == MeshEntityHandle::STATIC_BATCH;
+			if (!materialPerTriangle && Luminance(EmittedRadiance(pScene->MaterialBuffer[handle.MaterialIdx])) <= 0.0f) {
+				continue;
+			}
+
+			const glm::mat4& model = pScene->TransformBuffer[handle.TransformIdx];
+			const BVHAccel::TriangleView triangles = handle.IsIndexed()
+				? BVHAccel::TriangleView(assetPool->VertexBuffer, handle.FirstVertexIdx, assetPool->FaceBuffer, handle.FirstTriIdx)
+				: BVHAccel::TriangleView(assetPool->MeshBuffer, handle.FirstTriIdx, handle.FirstVertexIdx == MeshEntityHandle::PRECOMPUTED_TRIANGLES);
+			for (uint32_t i = 0; i < handle.TriCount; i++) {
+				const uint32_t materialIdx = handle.MaterialIdx +
+					(materialPerTriangle ? static_cast<uint32_t>(assetPool->MeshBuffer[handle.FirstTriIdx + i].v0.w) : 0);
+				const glm::vec3 radiance = EmittedRadiance(pScene->MaterialBuffer[materialIdx]);
+				if (Luminance(radiance) <= 0.0f) {
+					continue;
+				}
+
+				glm::vec3 v0, v1, v2;
+				triangles.Fetch(i, v0, v1, v2);
+				v0 = glm::vec3(model * glm::vec4(v0, 1.0f));
+				const glm::vec3 e1 = glm::vec3(model * glm::vec4(v1, 1.0f)) - v0;
+				const glm::vec3 e2 = glm::vec3(model * glm::vec4(v2, 1.0f)) - v0;
+				const float power = 0.5f * glm::length(glm::cross(e1, e2)) * Luminance(radiance);
+				if (!(power > 0.0f)) { // degenerate
+					continue;
+				}
+				totalPower += power;
+				m_EmissiveTriangles.push_back({ glm::vec4(v0, totalPower), glm::vec4(e1, 0.0f), glm::vec4(e2, 0.0f), glm::vec4(radiance, 0.0f) });
+			}
+		}
+
+		for (EmissiveTriangle& light : m_EmissiveTriangles) {
+			light.V0.w /= totalPower;
+		}
+		if (!m_EmissiveTriangles.empty()) {
+			m_EmissiveTriangles.back().V0.w = 1.0f; // no rounding gap at the end of the search
+		}
+		m_Cache.LightTotalPower = totalPower;
+	}
+
 	// returns false if error occured, else true
 	// assumes a valid pScene
 	bool Renderer::SetupGPUResources(std::shared_ptr<const ParsedScene> pScene, const Scene* scene, const AssetPool* assetPool) {
@@ -121,6 +697,8 @@ namespace X3
 
 		// SETTINGS
 		uint32_t entityCount = pScene->MeshEntityLookupTable.size();
+		uint32_t bvhWidth = (m_RenderSettings.bvhWidth == 4 || m_RenderSettings.bvhWidth == 8) ? m_RenderSettings.bvhWidth : 2;
+		uint32_t quantizedBVH = m_RenderSettings.quantizedBVH ? 1 : 0;
 		m_SettingsUBO->Bind();
 		m_SettingsUBO->AddData(0, sizeof(uint32_t), &m_RenderSettings.raysPerPixel);
 		m_SettingsUBO->AddData(4, sizeof(uint32_t), &m_RenderSettings.bouncesPerRay);
@@ -129,6 +707,14 @@ namespace X3
 		m_SettingsUBO->AddData(16, sizeof(uint32_t), &m_RenderSettings.debugMode);
 		m_SettingsUBO->AddData(20, sizeof(uint32_t), &m_RenderSettings.aabbHeatmapCutoff);
 		m_SettingsUBO->AddData(24, sizeof(uint32_t), &m_RenderSettings.triangleHeatmapCutoff);
+		m_SettingsUBO->AddData(28, sizeof(uint32_t), &bvhWidth);
+		m_SettingsUBO->AddData(32, sizeof(uint32_t), &quantizedBVH);
+		// no lights to sample turns next event estimation off
+		uint32_t lightCount = m_RenderSettings.nextEventEstimation ? static_cast<uint32_t>(m_EmissiveTriangles.size()) : 0;
+		m_SettingsUBO->AddData(56, sizeof(uint32_t), &lightCount);
+		m_SettingsUBO->AddData(60, sizeof(float), &m_Cache.LightTotalPower);
+		uint32_t anyHitShadowRays = m_RenderSettings.anyHitShadowRays ? 1 : 0;
+		m_SettingsUBO->AddData(64, sizeof(uint32_t), &anyHitShadowRays);
 		m_SettingsUBO->Unbind();
 
 		// CAMERA
@@ -138,41 +724,49 @@ namespace X3
 		m_CameraUBO->Unbind();
 
 
-		// Update SKYBOX texture if guid changed 
+		// Update SKYBOX texture if guid changed, along with the CDF it's importance sampled by
 		if (scene && scene->skyboxGuid != m_Cache.prevSkyboxGuid) {
 			m_Cache.prevSkyboxGuid = scene->skyboxGuid;
+			m_Cache.EnvironmentPdfScale = 0.0f;
+			m_SkyboxCdfTexture = nullptr;
 			auto metadata = assetPool->find<TextureMetadata>(pScene->skyboxGUID);
 			if (metadata) {
 				const uint32_t SKYBOX_TEXTURE_UNIT = 1;
 				const unsigned char* data = &assetPool->TextureBuffer[metadata->texStartIdx];
 				m_SkyboxTexture = ITexture2D::Create(data, metadata->width, metadata->height, SKYBOX_TEXTURE_UNIT);
+
+				auto t = m_Profiler->timer("Renderer::BuildEnvironmentCdf()");
+				const uint32_t SKYBOX_CDF_TEXTURE_UNIT = 2;
+				std::vector<float> cdf;
+				const double totalWeight = BuildEnvironmentCdf(data, metadata->width, metadata->height, metadata->channels, cdf);
+				if (totalWeight > 0.0) {
+					m_SkyboxCdfTexture = ITexture2D::Create(cdf.data(), metadata->width + 1, metadata->height, SKYBOX_CDF_TEXTURE_UNIT);
+					m_Cache.EnvironmentPdfScale = static_cast<float>(static_cast<double>(metadata->width) * metadata->height /
+						(totalWeight * 2.0 * glm::pi<double>() * glm::pi<double>()));
+				}
 			}
 			else {
 				m_SkyboxTexture = nullptr;
 			}
 		}
+		float envPdfScale = m_RenderSettings.nextEventEstimation ? m_Cache.EnvironmentPdfScale : 0.0f;
+		m_SettingsUBO->Bind();
+		m_SettingsUBO->AddData(68, sizeof(float), &envPdfScale);
+		m_SettingsUBO->Unbind();
 
 		// SSBOs - UPDATED EVERY FRAME 
 
 		{
 			// EntityLookupTable - BINDING POINT 0
-			uint32_t sizeBytes = sizeof(MeshEntityHandle) * pScene->MeshEntityLookupTable.size();
+			uint64_t sizeBytes = sizeof(MeshEntityHandle) * pScene->MeshEntityLookupTable.size();
 			m_MeshEntityLookupSSBO = IShaderStorageBuffer::Create(sizeBytes, 0, BufferUsageType::DYNAMIC_DRAW);
 			m_MeshEntityLookupSSBO->Bind();
 			m_MeshEntityLookupSSBO->AddData(0, sizeBytes, pScene->MeshEntityLookupTable.data());
 			m_MeshEntityLookupSSBO->Unbind();
 		}
-		{
-			// Transforms - BINDING POINT 1
-			uint32_t sizeBytes = sizeof(glm::mat4) * pScene->TransformBuffer.size();
-			m_TransformSSBO = IShaderStorageBuffer::Create(sizeBytes, 1, BufferUsageType::DYNAMIC_DRAW);
-			m_TransformSSBO->Bind();
-			m_TransformSSBO->AddData(0, sizeBytes, pScene->TransformBuffer.data());
-			m_TransformSSBO->Unbind();
-		}
 		{
 			// Materials - BINDING POINT 2
-			uint32_t sizeBytes = sizeof(Material) * pScene->MaterialBuffer.size();
+			uint64_t sizeBytes = sizeof(Material) * pScene->MaterialBuffer.size();
 			m_MaterialSSBO = IShaderStorageBuffer::Create(sizeBytes, 2, BufferUsageType::DYNAMIC_DRAW);
 			m_MaterialSSBO->Bind();
 			m_MaterialSSBO->AddData(0, sizeBytes, pScene->MaterialBuffer.data());
@@ -180,58 +774,88 @@ namespace X3
 		}
 
 		// SSBOs - UPDATED ON CHANGE 
+		// (Instance Transforms - BINDING POINT 1 - in UpdateInstanceTransforms())
+
+		// Emissive Triangles - BINDING POINT 17 (after UpdateLightList() rebuilt them)
+		if (!m_Cache.LightsUploaded) {
+			uint64_t sizeBytes = sizeof(EmissiveTriangle) * m_EmissiveTriangles.size();
+			m_LightSSBO = IShaderStorageBuffer::Create(sizeBytes, 17, BufferUsageType::DYNAMIC_DRAW);
+			m_LightSSBO->Bind();
+			m_LightSSBO->AddData(0, sizeBytes, m_EmissiveTriangles.data());
+			m_LightSSBO->Unbind();
+			m_Cache.LightsUploaded = true;
+		}
 
 		static uint32_t prevMeshBuffVersion = 0;
 		static uint32_t prevNodeBuffVersion = 0;
 		static uint32_t prevIndexBuffVersion = 0;
+		static uint32_t prevVertexBuffVersion = 0;
+		static uint32_t prevFaceBuffVersion = 0;
 		static uint32_t prevSkyboxTextureVersion = 0;
 
-		// Mesh Buffer - BINDING POINT 3
+		// TLAS Nodes & Indices - BINDING POINTS 6, 7 (only after a rebuild or refit)
 		{
-    		uint32_t currMeshBuffVersion = assetPool->GetUpdateVersion(AssetPool::AssetType::MeshBuffer);
-    		if (prevMeshBuffVersion != currMeshBuffVersion) {
-        		prevMeshBuffVersion = currMeshBuffVersion;
+			if (m_Cache.TLASUploadedVersion != m_TLAS.GetVersion()) {
+				m_Cache.TLASUploadedVersion = m_TLAS.GetVersion();
 
-        		uint32_t meshBuffer_sizeBytes = sizeof(Triangle) * assetPool->MeshBuffer.size();
-        		m_MeshBufferSSBO = IShaderStorageBuffer::Create(meshBuffer_sizeBytes, 3, BufferUsageType::STATIC_DRAW);
-        		m_MeshBufferSSBO->Bind();
-        		m_MeshBufferSSBO->AddData(0, meshBuffer_sizeBytes, assetPool->MeshBuffer.data());
-        		m_MeshBufferSSBO->Unbind();
-    		}
-		}
+				uint64_t nodes_sizeBytes = sizeof(BVHAccel::Node) * m_TLAS.GetNodes().size();
+				m_TLASNodeSSBO = IShaderStorageBuffer::Create(nodes_sizeBytes, 6, BufferUsageType::DYNAMIC_DRAW);
+				m_TLASNodeSSBO->Bind();
+				m_TLASNodeSSBO->AddData(0, nodes_sizeBytes, m_TLAS.GetNodes().data());
+				m_TLASNodeSSBO->Unbind();
 
-		// Node Buffer - BINDING POINT 4
-		{
-    		uint32_t currNodeBuffVersion = assetPool->GetUpdateVersion(AssetPool::AssetType::NodeBuffer);
-    		if (prevNodeBuffVersion != currNodeBuffVersion) {
-        		prevNodeBuffVersion = currNodeBuffVersion;
+				uint64_t indices_sizeBytes = sizeof(uint32_t) * m_TLAS.GetIndices().size();
+				m_TLASIndexSSBO = IShaderStorageBuffer::Create(indices_sizeBytes, 7, BufferUsageType::DYNAMIC_DRAW);
+				m_TLASIndexSSBO->Bind();
+				m_TLASIndexSSBO->AddData(0, indices_sizeBytes, m_TLAS.GetIndices().data());
+				m_TLASIndexSSBO->Unbind();
+			}
+		}
 
-        		uint32_t nodeBuffer_sizeBytes = sizeof(BVHAccel::Node) * assetPool->NodeBuffer.size();
-        		m_NodeBufferSSBO = IShaderStorageBuffer::Create(nodeBuffer_sizeBytes, 4, BufferUsageType::STATIC_DRAW);
-        		m_NodeBufferSSBO->Bind();
-        		m_NodeBufferSSBO->AddData(0, nodeBuffer_sizeBytes, assetPool->NodeBuffer.data());
-        		m_NodeBufferSSBO->Unbind();
-    		}
+		// Mesh Buffer - BINDING POINTS 3 (12), Vertex & Face Buffers - BINDING POINTS 10, 11
+		// each layout is only uploaded once a rendered mesh uses it
+		const auto& lookupTable = pScene->MeshEntityLookupTable;
+		const bool anyIndexed = std::any_of(lookupTable.begin(), lookupTable.end(), [](const MeshEntityHandle& handle) {
+			return handle.IsIndexed(); });
+		const bool anyNotIndexed = std::any_of(lookupTable.begin(), lookupTable.end(), [](const MeshEntityHandle& handle) {
+			return !handle.IsIndexed(); });
+		if (anyNotIndexed) {
+			UploadAssetBuffer(m_MeshBufferSSBO, assetPool->MeshBuffer, assetPool, AssetPool::AssetType::MeshBuffer, prevMeshBuffVersion);
+		}
+		if (anyIndexed) {
+			UploadAssetBuffer(m_VertexBufferSSBO, assetPool->VertexBuffer, assetPool, AssetPool::AssetType::VertexBuffer, prevVertexBuffVersion);
+			UploadAssetBuffer(m_FaceBufferSSBO, assetPool->FaceBuffer, assetPool, AssetPool::AssetType::FaceBuffer, prevFaceBuffVersion);
 		}
 
-		// Index Buffer - BINDING POINT 5 
-		{
-    		uint32_t currIndexBuffVersion = assetPool->GetUpdateVersion(AssetPool::AssetType::IndexBuffer);
-    		if (prevIndexBuffVersion != currIndexBuffVersion) {
-        		prevIndexBuffVersion = currIndexBuffVersion;
+		// Node Buffer - BINDING POINTS 4 (13)
+		UploadAssetBuffer(m_NodeBufferSSBO, assetPool->NodeBuffer, assetPool, AssetPool::AssetType::NodeBuffer, prevNodeBuffVersion);
 
-        		uint32_t indexBuffer_sizeBytes = sizeof(uint32_t) * assetPool->IndexBuffer.size();
-        		m_IndexBufferSSBO = IShaderStorageBuffer::Create(indexBuffer_sizeBytes, 5, BufferUsageType::STATIC_DRAW);
-        		m_IndexBufferSSBO->Bind();
-        		m_IndexBufferSSBO->AddData(0, indexBuffer_sizeBytes, assetPool->IndexBuffer.data());
-        		m_IndexBufferSSBO->Unbind();
-    		}
+		// Index Buffer - BINDING POINTS 5 (14)
+		// only read for meshes which aren't leaf ordered, without any the upload is skipped until one shows up
+		if (std::any_of(lookupTable.begin(), lookupTable.end(), [](const MeshEntityHandle& handle) {
+				return handle.FirstIndexIdx != MeshEntityHandle::LEAF_ORDERED; })) {
+			UploadAssetBuffer(m_IndexBufferSSBO, assetPool->IndexBuffer, assetPool, AssetPool::AssetType::IndexBuffer, prevIndexBuffVersion);
 		}
 
+		// shard sizes only change with a full upload above
+		m_SettingsUBO->Bind();
+		m_SettingsUBO->AddData(36, sizeof(uint32_t), &m_MeshBufferSSBO.ShardElements);
+		m_SettingsUBO->AddData(40, sizeof(uint32_t), &m_NodeBufferSSBO.ShardElements);
+		m_SettingsUBO->AddData(44, sizeof(uint32_t), &m_IndexBufferSSBO.ShardElements);
+		m_SettingsUBO->Unbind();
+
 		return true;
 	}
 
 	void Renderer::Draw() {
+		if (m_RenderSettings.wavefront && PrepareWavefront()) {
+			DrawWavefront();
+			return;
+		}
+		if (m_RenderSettings.persistentThreads && PreparePersistentThreads()) {
+			DrawPersistentThreads();
+			return;
+		}
 		auto t = m_Profiler->timer("Renderer::Draw()");
 		m_Shader->Bind();
 		m_Shader->setWorkGroupSizes(glm::uvec3(
@@ -241,4 +865,120 @@ namespace X3
 		  ));
 		m_Shader->Dispatch();
 	}
-}
\ No newline at end of file
+
+	std::shared_ptr<IComputeShader> Renderer::CreateShaderVariant(const char* define) const {
+		auto shader = IComputeShader::Create(m_ComputeShaderPath.string(), glm::uvec3(1), { define });
+		return (shader && shader->GetID() != 0) ? shader : nullptr;
+	}
+
+	bool Renderer::PrepareWavefront() {
+		if (m_Cache.WavefrontUnavailable) {
+			return false;
+		}
+		if (!m_GenerateShader) {
+			m_GenerateShader = CreateShaderVariant("WAVEFRONT_GENERATE");
+			m_ExtendShader = CreateShaderVariant("WAVEFRONT_EXTEND");
+			m_ShadeShader = CreateShaderVariant("WAVEFRONT_SHADE");
+			m_ShadowShader = CreateShaderVariant("WAVEFRONT_SHADOW");
+			m_AccumulateShader = CreateShaderVariant("WAVEFRONT_ACCUMULATE");
+			if (!m_GenerateShader || !m_ExtendShader || !m_ShadeShader || !m_ShadowShader || !m_AccumulateShader) {
+				LOG_ENGINE_ERROR("PrepareWavefront: unable to compile the wavefront stages, rendering with the megakernel");
+				m_Cache.WavefrontUnavailable = true;
+				return false;
+			}
+		}
+
+		// Wavefront Paths & Ray Queues - BINDING POINTS 15, 16
+		const uint32_t pathCount = m_RenderSettings.resolution.x * m_RenderSettings.resolution.y;
+		if (pathCount != m_Cache.WavefrontPathCount) {
+			m_WavefrontPathSSBO = IShaderStorageBuffer::Create(WAVEFRONT_PATH_STATE_SIZE * pathCount, 15, BufferUsageType::DYNAMIC_DRAW);
+			m_WavefrontQueueSSBO = IShaderStorageBuffer::Create(WAVEFRONT_QUEUE_COUNT * (4 * sizeof(uint32_t) + sizeof(uint32_t) * static_cast<uint64_t>(pathCount)),
+																16, BufferUsageType::DYNAMIC_DRAW);
+			m_Cache.WavefrontPathCount = pathCount;
+		}
+		return true;
+	}
+
+	void Renderer::DrawWavefront() {
+		auto t = m_Profiler->timer("Renderer::DrawWavefront()");
+		const uint32_t pathCount = m_Cache.WavefrontPathCount;
+		const uint32_t pathGroups = (pathCount + GROUP_SIZE_1D - 1) / GROUP_SIZE_1D;
+
+		// QueueHeader { groupsX, groupsY, groupsZ, count } of ray queue 0 & 1 and the shadow ray queue 2
+		const std::array<uint32_t, 4> allPaths = { pathGroups, 1, 1, pathCount };
+		const std::array<uint32_t, 4> emptyQueue = { 0, 1, 1, 0 };
+		auto ResetQueue = [this](uint32_t queue, const std::array<uint32_t, 4>& header) {
+			m_WavefrontQueueSSBO->Bind();
+			m_WavefrontQueueSSBO->AddData(sizeof(header) * queue, sizeof(header), header.data());
+			m_WavefrontQueueSSBO->Unbind();
+		};
+		auto SetStep = [this](uint32_t sample, uint32_t bounce) {
+			m_SettingsUBO->Bind();
+			m_SettingsUBO->AddData(48, sizeof(uint32_t), &sample);
+			m_SettingsUBO->AddData(52, sizeof(uint32_t), &bounce);
+			m_SettingsUBO->Unbind();
+		};
+
+		for (uint32_t sample = 0; sample < static_cast<uint32_t>(m_RenderSettings.raysPerPixel); sample++) {
+			SetStep(sample, 0);
+			ResetQueue(0, allPaths);
+			m_GenerateShader->Bind();
+			m_GenerateShader->setWorkGroupSizes(glm::uvec3(pathGroups, 1, 1));
+			m_GenerateShader->Dispatch();
+
+			// the paths shaded at one bounce are extended at the next from the other queue, the queue being
+			// extended keeps its arguments for the shading pass over the same paths. Light samples taken by
+			// the shading pass are traced right after it
+			const bool sampleLights = m_RenderSettings.nextEventEstimation && !m_EmissiveTriangles.empty();
+			for (uint32_t bounce = 0; bounce < static_cast<uint32_t>(m_RenderSettings.bouncesPerRay); bounce++) {
+				const uint32_t queue = bounce & 1;
+				SetStep(sample, bounce);
+				ResetQueue(queue ^ 1, emptyQueue);
+				ResetQueue(2, emptyQueue);
+				m_ExtendShader->Bind();
+				m_ExtendShader->DispatchIndirect(*m_WavefrontQueueSSBO, sizeof(allPaths) * queue);
+				m_ShadeShader->Bind();
+				m_ShadeShader->DispatchIndirect(*m_WavefrontQueueSSBO, sizeof(allPaths) * queue);
+				if (sampleLights) {
+					m_ShadowShader->Bind();
+					m_ShadowShader->DispatchIndirect(*m_WavefrontQueueSSBO, sizeof(allPaths) * 2);
+				}
+			}
+		}
+
+		m_AccumulateShader->Bind();
+		m_AccumulateShader->setWorkGroupSizes(glm::uvec3(pathGroups, 1, 1));
+		m_AccumulateShader->Dispatch();
+	}
+
+	bool Renderer::PreparePersistentThreads() {
+		if (m_Cache.PersistentThreadsUnavailable) {
+			return false;
+		}
+		if (!m_PersistentShader) {
+			m_PersistentShader = CreateShaderVariant("PERSISTENT_THREADS");
+			if (!m_PersistentShader) {
+				LOG_ENGINE_ERROR("PreparePersistentThreads: unable to compile the persistent threads kernel, rendering with the megakernel");
+				m_Cache.PersistentThreadsUnavailable = true;
+				return false;
+			}
+			// Persistent Work Counter - ATOMIC COUNTER BINDING POINT 0, no shader storage block left for it
+			// next to the geometry, materials & lights
+			m_PersistentWorkSSBO = IShaderStorageBuffer::CreateAtomicCounter(sizeof(uint32_t), 0, BufferUsageType::DYNAMIC_DRAW);
+		}
+		return true;
+	}
+
+	void Renderer::DrawPersistentThreads() {
+		auto t = m_Profiler->timer("Renderer::DrawPersistentThreads()");
+		const uint32_t pixelCount = m_RenderSettings.resolution.x * m_RenderSettings.resolution.y;
+		const uint32_t nextPixel = 0;
+		m_PersistentWorkSSBO->Bind();
+		m_PersistentWorkSSBO->AddData(0, sizeof(nextPixel), &nextPixel);
+		m_PersistentWorkSSBO->Unbind();
+
+		m_PersistentShader->Bind();
+		m_PersistentShader->setWorkGroupSizes(glm::uvec3(std::min((pixelCount + GROUP_SIZE_1D - 1) / GROUP_SIZE_1D, PERSISTENT_WORK_GROUPS), 1, 1));
+		m_PersistentShader->Dispatch();
+	}
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "lrpch.h"
+#include <array>
 #include "Renderer/RenderSettings.h"
 #include "Renderer/IRendererAPI.h"
+#include "Renderer/TLAS.h"
 #include "Core/GUID.h"
 #include "EngineCfg.h"
 
@@ -22,39 +24,153 @@ namespace X3 {
 
 namespace X3 
 {
+
+	// An AssetPool buffer spread over SSBOs no larger than the device's shader storage block size.
+	// Element i lives in shard i / ShardElements at i % ShardElements, PathTracing.comp picks the shard
+	// with the u_...ShardSize uniforms. Buffers needing more shards than the shader declares aren't uploaded.
+	// Shards grow geometrically as the buffer is appended to, so imports only upload the new elements.
+	static constexpr uint32_t MAX_SSBO_SHARDS = 2;
+	struct ShardedSSBO {
+		std::array<uint32_t, MAX_SSBO_SHARDS> BindingPoints;
+		uint32_t ShardCount; // BindingPoints declared by the shader
+		std::array<std::shared_ptr<IShaderStorageBuffer>, MAX_SSBO_SHARDS> Shards{};
+		std::array<uint64_t, MAX_SSBO_SHARDS> Capacities{}; // in elements, at most ShardElements
+		uint32_t ShardElements = UINT32_MAX; // the device's block size in elements
+	};
 	
 	class Renderer {
 	private:
+		static constexpr uint32_t STATIC_BATCH_ENTITY_ID = 0xFFFFFFFF; // entt::null, never a real entity
+		static constexpr uint32_t GROUP_SIZE_1D = 64; // local size of the wavefront stages & persistent threads in PathTracing.comp
+		static constexpr uint32_t PERSISTENT_WORK_GROUPS = 1024; // enough lanes to fill current GPUs, fewer if the frame has fewer pixels
+		static constexpr uint64_t WAVEFRONT_PATH_STATE_SIZE = 112; // std430 PathState in PathTracing.comp
+		static constexpr uint32_t WAVEFRONT_QUEUE_COUNT = 3; // two ray queues ping-ponged between bounces & the shadow ray queue
+
 
 		struct Cache {
 			glm::uvec2 Resolution{0};
 			uint32_t AccumulatedFrames = 0;
 			LR_GUID prevSkyboxGuid = LR_GUID::INVALID;
+			float EnvironmentPdfScale = 0.0f; // m_SkyboxCdfTexture's texel count / (summed weight * 2π²), 0 without a sky to sample
+
+			// per MeshEntityLookupTable entry the TLAS was last built/refit with
+			std::vector<uint32_t> TLASEntityIds;
+			std::vector<uint32_t> TLASTransformVersions;
+			std::vector<uint32_t> TLASFirstNodeIdx;
+			uint32_t TLASNodeBufferVersion = 0;
+			uint32_t TLASUploadedVersion = 0; // m_TLAS version currently on the GPU
+
+			// collapsed BVHs in m_WidePackets, keyed by the mesh's FirstNodeIdx
+			struct WideBVHRange {
+				uint32_t NodeCount;
+				uint32_t FirstPacketIdx;
+				uint32_t PacketCount;
+			};
+			std::unordered_map<uint32_t, WideBVHRange> WideBVHRanges;
+			uint32_t WideBVHWidth = 0;
+			bool WideBVHQuantized = false;
+			uint32_t WideBVHNodeBufferVersion = 0;
+			uint32_t WideBVHUnusedPackets = 0; // left behind by removed or rebuilt BVHs until the next full update
+
+			// static entities merged into the static batch mesh, sorted by id - material slot i belongs to StaticBatchEntityIds[i]
+			LR_GUID StaticBatchGuid; // random, the batch lives in the AssetPool but isn't a project asset
+			std::vector<uint32_t> StaticBatchEntityIds;
+			std::vector<uint32_t> StaticBatchTransformVersions;
+			std::vector<LR_GUID> StaticBatchMeshGuids;
+			// where the triangles of StaticBatchMeshGuids[i] were when the batch was baked, a mesh loaded, rebuilt
+			// or moved by compaction since then has to be baked again
+			struct StaticBatchMeshRange {
+				uint32_t FirstTriIdx = 0;
+				uint32_t TriCount = 0;
+				uint32_t FirstVertexIdx = 0;
+				uint32_t NodeCount = 0; // 0 - not loaded (yet)
+				bool operator==(const StaticBatchMeshRange&) const = default;
+			};
+			std::vector<StaticBatchMeshRange> StaticBatchMeshRanges;
+
+			uint32_t WavefrontPathCount = 0; // pixels the wavefront path & queue SSBOs are sized for
+			bool WavefrontUnavailable = false; // a stage failed to compile, the megakernel is used instead
+			bool PersistentThreadsUnavailable = false; // same for the persistent threads kernel
+
+			// inputs m_EmissiveTriangles was last built from
+			std::vector<uint32_t> LightEntityIds;
+			std::vector<uint32_t> LightTransformVersions;
+			std::vector<Material> LightMaterials;
+			std::array<uint32_t, 4> LightGeometryVersions{}; // Mesh, Vertex, Face & Metadata
+			bool LightListBuilt = false;
+			float LightTotalPower = 0.0f;
+			bool LightsUploaded = false; // m_LightSSBO holds m_EmissiveTriangles
+
+			// per MeshEntityLookupTable entry m_InstanceTransforms was last computed for
+			std::vector<uint32_t> InstanceEntityIds;
+			std::vector<uint32_t> InstanceTransformVersions;
+			std::vector<uint32_t> InstanceFirstNodeIdx;
+			uint32_t InstanceNodeBufferVersion = 0;
+		};
+
+		// Under the std430 - 208 bytes
+		// Everything the shader needs to move rays in & out of an entity's local space, only recomputed when the entity moved
+		struct InstanceTransform {
+			glm::mat4 Model{ 1.0f };
+			glm::mat4 InverseModel{ 1.0f };
+			glm::mat3x4 NormalMatrix{ 1.0f }; // transpose(inverse(mat3(Model))), std430 mat3 columns are padded to vec4
+			glm::vec4 WorldMin{ 0.0f };		  // bounds of the mesh's root node in world space, .w unused
+			glm::vec4 WorldMax{ 0.0f };
 		};
 
-		// Under the std430 - 24 bytes
+		// Under the std430 - 64 bytes
+		// A triangle of an emissive entity in world space, PathTracing.comp picks one with probability proportional to its power
+		// (area * luminance of its radiance) by a binary search over the CDF, then a uniformly distributed point on it
+		struct EmissiveTriangle {
+			glm::vec4 V0{ 0.0f };		// .w - CDF up to & including this triangle, the last one is 1
+			glm::vec4 E1{ 0.0f };		// v1 - v0, .w unused
+			glm::vec4 E2{ 0.0f };		// v2 - v0, .w unused
+			glm::vec4 Radiance{ 0.0f }; // emission * strength * color (emitters are tinted by their color), .w unused
+		};
+
+		// Under the std430 - 40 bytes
 		struct MeshEntityHandle {
-			uint32_t FirstTriIdx = 0;
+			uint32_t FirstTriIdx = 0; // into the FaceBuffer for indexed meshes
 			uint32_t TriCount = 0;
 			uint32_t FirstNodeIdx = 0;
 			uint32_t NodeCount = 0;
+			uint32_t FirstIndexIdx = 0; // LEAF_ORDERED - leaves index the MeshBuffer directly
+			uint32_t IndexCount = 0;
 			uint32_t TransformIdx = 0;
 			uint32_t MaterialIdx = 0;
+			uint32_t FirstWidePacketIdx = 0; // only valid if RenderSettings::bvhWidth > 2
+			uint32_t FirstVertexIdx = 0; // NOT_INDEXED - standalone Triangles in the MeshBuffer, PRECOMPUTED_TRIANGLES - same in ToPrecomputedTriangle() form,
+										 // STATIC_BATCH - same in world space, MaterialIdx + v0.w is the triangle's material
+
+			static constexpr uint32_t LEAF_ORDERED = 0xFFFFFFFF;
+			static constexpr uint32_t NOT_INDEXED = 0xFFFFFFFF;
+			static constexpr uint32_t PRECOMPUTED_TRIANGLES = 0xFFFFFFFE;
+			static constexpr uint32_t STATIC_BATCH = 0xFFFFFFFD;
+
+			inline bool IsIndexed() const { return FirstVertexIdx < STATIC_BATCH; }
 
 			MeshEntityHandle(uint32_t firstTriIdx, uint32_t triCount,
 							 uint32_t firstNodeIdx, uint32_t nodeCount,
-							 uint32_t transformIdx, uint32_t materialIdx)
+							 uint32_t firstIndexIdx, uint32_t indexCount,
+							 uint32_t transformIdx, uint32_t materialIdx,
+							 uint32_t firstWidePacketIdx, uint32_t firstVertexIdx)
 				: FirstTriIdx(firstTriIdx), TriCount(triCount),
 				  FirstNodeIdx(firstNodeIdx), NodeCount(nodeCount),
-				  TransformIdx(transformIdx), MaterialIdx(materialIdx) {}
+				  FirstIndexIdx(firstIndexIdx), IndexCount(indexCount),
+				  TransformIdx(transformIdx), MaterialIdx(materialIdx),
+				  FirstWidePacketIdx(firstWidePacketIdx), FirstVertexIdx(firstVertexIdx) {}
 		};
 
 		struct ParsedScene {
 			std::vector<MeshEntityHandle> MeshEntityLookupTable; // only renderable entities in the scene
 
-			// MeshBuffer, NodeBuffer & IndexBuffer are stored in the AssetPool
+			// MeshBuffer, VertexBuffer, FaceBuffer, NodeBuffer & IndexBuffer are stored in the AssetPool
 			std::vector<Material> MaterialBuffer;
-			std::vector<glm::mat4> TransformBuffer;
+			std::vector<glm::mat4> TransformBuffer; // world matrices, expanded into m_InstanceTransforms on the GPU
+
+			// parallel to MeshEntityLookupTable - identify entities & their moves across frames
+			std::vector<uint32_t> EntityIds; // STATIC_BATCH_ENTITY_ID for the static batch
+			std::vector<uint32_t> TransformVersions;
 
 			bool hasValidCamera = false;
 			float CameraFocalLength = 0;
@@ -74,21 +190,59 @@ namespace X3
 		inline void applySettings(RenderSettings renderSettings) { m_RenderSettings = renderSettings; }
 
 		void Init();
+		// Re-bakes the static batch (AssetManager::BuildStaticBatch()) over the entities with MeshComponent::isStatic set,
+		// only once one of them was added, removed, moved or its mesh changed. Call before Render()
+		void UpdateStaticBatch(const Scene* scene, AssetManager& assetManager);
 		std::shared_ptr<IImage2D> Render(const Scene* scene, const AssetPool* resourcePool);
 
 	private:
+		// Collapses the mesh BVHs to RenderSettings::bvhWidth (quantized if requested) & uploads them, refit meshes are re-collapsed in place
+		void UpdateWideBVH(const AssetPool* resourcePool);
 		std::shared_ptr<const ParsedScene> Parse(const Scene* scene, const AssetPool* resourcePool) const;
+		// Recomputes & re-uploads the InstanceTransforms of moved entities (and of those whose BLAS was refit), all of them once the entities changed
+		void UpdateInstanceTransforms(std::shared_ptr<const ParsedScene> pScene, const AssetPool* resourcePool);
+		// Refits the TLAS for moved entities, rebuilds it if the entities changed or the refit degraded it
+		void UpdateTLAS(std::shared_ptr<const ParsedScene> pScene, const AssetPool* resourcePool);
+		// Rebuilds m_EmissiveTriangles from the entities with emission.w > 0 once one of them moved, a material or the geometry changed
+		void UpdateLightList(std::shared_ptr<const ParsedScene> pScene, const AssetPool* resourcePool);
 		bool SetupGPUResources(std::shared_ptr<const ParsedScene> pScene, const Scene* scene, const AssetPool* resourcePool);
 		void Draw(); // Draws directly to m_Frame
+		// PathTracing.comp compiled with 'define', nullptr if that fails
+		std::shared_ptr<IComputeShader> CreateShaderVariant(const char* define) const;
+		// RenderSettings::wavefront - compiles the stages on first use, returns false if they aren't available
+		bool PrepareWavefront();
+		void DrawWavefront();
+		// RenderSettings::persistentThreads - same
+		bool PreparePersistentThreads();
+		void DrawPersistentThreads();
 
 
 		std::shared_ptr<Profiler> m_Profiler;
 
 		std::shared_ptr<IComputeShader> m_Shader;
+		std::shared_ptr<IComputeShader> m_GenerateShader, m_ExtendShader, m_ShadeShader, m_ShadowShader, m_AccumulateShader; // wavefront stages
+		std::shared_ptr<IComputeShader> m_PersistentShader;
 		std::shared_ptr<IImage2D> m_Frame;
 		std::shared_ptr<ITexture2D> m_SkyboxTexture;
+		std::shared_ptr<ITexture2D> m_SkyboxCdfTexture; // luminance-weighted CDF to importance sample the skybox, texture unit 2
 		std::shared_ptr<IUniformBuffer> m_CameraUBO, m_SettingsUBO;
-		std::shared_ptr<IShaderStorageBuffer> m_MeshEntityLookupSSBO, m_MeshBufferSSBO, m_NodeBufferSSBO, m_IndexBufferSSBO, m_MaterialSSBO, m_TransformSSBO;
+		std::shared_ptr<IShaderStorageBuffer> m_MeshEntityLookupSSBO, m_MaterialSSBO, m_TransformSSBO;
+		ShardedSSBO m_MeshBufferSSBO{ { 3, 12 }, 2 };
+		ShardedSSBO m_NodeBufferSSBO{ { 4, 13 }, 2 };
+		ShardedSSBO m_IndexBufferSSBO{ { 5, 14 }, 2 };
+		ShardedSSBO m_VertexBufferSSBO{ { 10 }, 1 };
+		ShardedSSBO m_FaceBufferSSBO{ { 11 }, 1 };
+		std::shared_ptr<IShaderStorageBuffer> m_TLASNodeSSBO, m_TLASIndexSSBO;
+		std::shared_ptr<IShaderStorageBuffer> m_WavefrontPathSSBO, m_WavefrontQueueSSBO; // binding points 15, 16
+		std::shared_ptr<IShaderStorageBuffer> m_PersistentWorkSSBO; // atomic counter binding point 0
+		std::shared_ptr<IShaderStorageBuffer> m_LightSSBO; // binding point 17
+		ShardedSSBO m_WideNodeSSBO{ { 8 }, 1 }; // float or quantized packets, binding point 9 for the latter
+
+		TLAS m_TLAS;
+		std::vector<InstanceTransform> m_InstanceTransforms; // indexed by MeshEntityHandle::TransformIdx
+		std::vector<BVHAccel::WidePacket> m_WidePackets;
+		std::vector<BVHAccel::QuantizedPacket> m_QuantizedPackets; // only kept up to date if RenderSettings::quantizedBVH
+		std::vector<EmissiveTriangle> m_EmissiveTriangles;
 		
 		Cache m_Cache;
 		RenderSettings m_RenderSettings;
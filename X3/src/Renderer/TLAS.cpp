@@ -0,0 +1,94 @@
+#include "Renderer/TLAS.h"
+
+namespace X3
+{
+
+	static float NodeWeight(const BVHAccel::Node& node) {
+		return (node.triCount != 0) ? float(node.triCount) : 1.0f;
+	}
+
+	static float NodeArea(const BVHAccel::Node& node) {
+		return BVHAccel::Aabb(node.min, node.max).area();
+	}
+
+	void TLAS::Build(const std::vector<BVHAccel::Aabb>& entityBounds) {
+		m_EntityBounds = entityBounds;
+		m_Nodes.clear();
+		m_Indices.clear();
+
+		uint32_t firstNodeIdx, nodeCount, firstIndexIdx, indexCount;
+		BVHAccel bvh(m_EntityBounds);
+		bvh.Build(m_Nodes, m_Indices, firstNodeIdx, nodeCount, firstIndexIdx, indexCount);
+
+		// links needed to walk from a leaf up to the root
+		m_Parents.assign(m_Nodes.size(), 0);
+		m_LeafOfEntity.assign(m_EntityBounds.size(), 0);
+		m_SAHSum = 0.0f;
+		for (uint32_t nodeIdx = 0; nodeIdx < m_Nodes.size(); nodeIdx++) {
+			const BVHAccel::Node& node = m_Nodes[nodeIdx];
+			m_SAHSum += NodeArea(node) * NodeWeight(node);
+			if (node.triCount == 0) {
+				m_Parents[node.leftChild_Or_FirstTri] = nodeIdx;
+				m_Parents[node.leftChild_Or_FirstTri + 1] = nodeIdx;
+			} else {
+				for (uint32_t i = 0; i < node.triCount; i++) {
+					m_LeafOfEntity[m_Indices[node.leftChild_Or_FirstTri + i]] = nodeIdx;
+				}
+			}
+		}
+
+		m_BuildSAHCost = ComputeSAHCost();
+		m_Version++;
+	}
+
+	void TLAS::Refit(const std::vector<uint32_t>& movedEntities, const std::vector<BVHAccel::Aabb>& movedBounds) {
+		for (size_t k = 0; k < movedEntities.size(); k++) {
+			m_EntityBounds[movedEntities[k]] = movedBounds[k];
+		}
+
+		for (uint32_t entityIdx : movedEntities) {
+			uint32_t nodeIdx = m_LeafOfEntity[entityIdx];
+			while (true) {
+				BVHAccel::Node& node = m_Nodes[nodeIdx];
+				BVHAccel::Aabb bounds;
+				if (node.triCount != 0) {
+					for (uint32_t i = 0; i < node.triCount; i++) {
+						bounds.grow(m_EntityBounds[m_Indices[node.leftChild_Or_FirstTri + i]]);
+					}
+				} else {
+					const BVHAccel::Node& left = m_Nodes[node.leftChild_Or_FirstTri];
+					const BVHAccel::Node& right = m_Nodes[node.leftChild_Or_FirstTri + 1];
+					bounds.grow(BVHAccel::Aabb(left.min, left.max));
+					bounds.grow(BVHAccel::Aabb(right.min, right.max));
+				}
+
+				// nothing above changes either (other moved entities walk their own path)
+				if (bounds.boxMin == node.min && bounds.boxMax == node.max) {
+					break;
+				}
+
+				m_SAHSum += (bounds.area() - NodeArea(node)) * NodeWeight(node);
+				node.min = bounds.boxMin;
+				node.max = bounds.boxMax;
+
+				if (nodeIdx == 0) {
+					break;
+				}
+				nodeIdx = m_Parents[nodeIdx];
+			}
+		}
+		m_Version++;
+	}
+
+	float TLAS::GetSAHRatio() const {
+		return (m_BuildSAHCost > 0.0f) ? ComputeSAHCost() / m_BuildSAHCost : 1.0f;
+	}
+
+	float TLAS::ComputeSAHCost() const {
+		if (m_Nodes.empty()) {
+			return 0.0f;
+		}
+		const float rootArea = NodeArea(m_Nodes[0]);
+		return (rootArea > 0.0f) ? m_SAHSum / rootArea : 0.0f;
+	}
+}
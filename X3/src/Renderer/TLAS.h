@@ -0,0 +1,55 @@
+#pragma once
+
+#include "lrpch.h"
+#include "Project/Assets/BVHAccel.h"
+
+namespace X3
+{
+
+	// ============================================================================
+	// TLAS (Top Level Acceleration Structure)
+	// ----------------------------------------------------------------------------
+	// BVH over the world space bounds of the renderable entities, leaves index
+	// into the renderer's MeshEntityLookupTable. Kept alive across frames so
+	// moved entities only refit their own path to the root. The tree topology
+	// degrades with every refit, once its SAH grows past REBUILD_SAH_RATIO of
+	// the freshly built tree the owner should call Build() again.
+	// ============================================================================
+	class TLAS {
+	public:
+		// refit trees costing more than this times the freshly built one get rebuilt
+		static constexpr float REBUILD_SAH_RATIO = 1.3f;
+
+		/// Builds from scratch, entity i is bounded by entityBounds[i].
+		void Build(const std::vector<BVHAccel::Aabb>& entityBounds);
+
+		/// Moves 'movedEntities[k]' to 'movedBounds[k]' and refits their leaves & ancestors.
+		/// Cost is O(moved * depth), unchanged subtrees stop the walk early.
+		void Refit(const std::vector<uint32_t>& movedEntities, const std::vector<BVHAccel::Aabb>& movedBounds);
+
+		/// SAH cost of the current tree relative to the one produced by the last Build()
+		float GetSAHRatio() const;
+		inline bool NeedsRebuild() const { return GetSAHRatio() > REBUILD_SAH_RATIO; }
+
+		inline const std::vector<BVHAccel::Node>& GetNodes() const { return m_Nodes; }
+		inline const std::vector<uint32_t>& GetIndices() const { return m_Indices; }
+		inline uint32_t GetEntityCount() const { return static_cast<uint32_t>(m_EntityBounds.size()); }
+
+		/// Incremented by every Build() & Refit(), compare against a cached value to detect changes
+		inline uint32_t GetVersion() const { return m_Version; }
+
+	private:
+		// SAH cost normalized by the root's area, same weighting as the builder (interior 1, leaf triCount)
+		float ComputeSAHCost() const;
+
+		std::vector<BVHAccel::Node> m_Nodes;
+		std::vector<uint32_t> m_Indices;		// leaf ranges -> entity index
+		std::vector<uint32_t> m_Parents;		// per node, root points to itself
+		std::vector<uint32_t> m_LeafOfEntity;	// entity index -> node index of its leaf
+		std::vector<BVHAccel::Aabb> m_EntityBounds;
+
+		float m_SAHSum = 0.0f;		// un-normalized SAH of m_Nodes, kept up to date by Refit()
+		float m_BuildSAHCost = 0.0f;
+		uint32_t m_Version = 0;
+	};
+}